@@ -0,0 +1,566 @@
+/*
+Direction-optimizing breadth-first search on a graph in CSR format.
+https://parlab.eecs.berkeley.edu/sites/all/parlab/files/main.pdf (Beamer et al.)
+
+CSR (compressed sparse row) stores the neighbors of vertex v in
+neighbors[offsets[v] .. offsets[v + 1]).
+
+BFS is level-synchronous: level d+1 is found from level d, with a barrier between.
+1. top-down:  every frontier vertex checks its neighbors and claims unvisited ones
+              with a compare-and-swap on parent[]. Each thread appends to its own
+              queue. A prefix sum over the queue sizes gives every thread its offset
+              in the next frontier, so the queues are merged without locks.
+2. bottom-up: every unvisited vertex scans its neighbors for one that is in the
+              frontier (a bitmap) and stops at the first. Good when the frontier
+              is a large fraction of the graph, because most edges are skipped.
+
+The search starts top-down, switches to bottom-up when the frontier's edges exceed
+1/ALPHA of the unexplored edges, and switches back when the frontier has fewer than
+n/BETA vertices.
+
+Performance is reported in TEPS: traversed edges per second.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+using Vertex = int32_t;
+using EdgeList = vector<pair<Vertex, Vertex>>;
+
+constexpr int ALPHA = 15;
+constexpr int BETA = 18;
+
+struct CsrGraph
+{
+    Vertex numVertices{};
+    vector<int64_t> offsets;   // numVertices + 1 entries
+    vector<Vertex> neighbors; // both directions of every undirected edge
+
+    int64_t degree(Vertex v) const { return offsets[v + 1] - offsets[v]; }
+};
+
+// builds an undirected CSR graph. self loops are dropped.
+CsrGraph buildCsr(const EdgeList &edges, Vertex numVertices)
+{
+    CsrGraph g;
+    g.numVertices = numVertices;
+    vector<int64_t> degree(numVertices, 0);
+
+    const int64_t m = static_cast<int64_t>(edges.size());
+    #pragma omp parallel for
+    for (int64_t e = 0; e < m; ++e)
+    {
+        auto [u, v] = edges[e];
+        if (u == v)
+            continue;
+        #pragma omp atomic
+        ++degree[u];
+        #pragma omp atomic
+        ++degree[v];
+    }
+
+    g.offsets.assign(numVertices + 1, 0);
+    inclusive_scan(degree.begin(), degree.end(), g.offsets.begin() + 1);
+    g.neighbors.resize(g.offsets.back());
+
+    // reuse 'degree' as the next free slot of each vertex
+    copy(g.offsets.begin(), g.offsets.end() - 1, degree.begin());
+
+    #pragma omp parallel for
+    for (int64_t e = 0; e < m; ++e)
+    {
+        auto [u, v] = edges[e];
+        if (u == v)
+            continue;
+
+        int64_t slotU, slotV;
+        #pragma omp atomic capture
+        slotU = degree[u]++;
+        #pragma omp atomic capture
+        slotV = degree[v]++;
+
+        g.neighbors[slotU] = v;
+        g.neighbors[slotV] = u;
+    }
+
+    // sorted neighbor lists make the result independent of the fill order
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (Vertex v = 0; v < numVertices; ++v)
+        sort(g.neighbors.begin() + g.offsets[v], g.neighbors.begin() + g.offsets[v + 1]);
+
+    return g;
+}
+
+// reads "u v" pairs, one per line. lines starting with '#' or '%' are comments (SNAP, Matrix Market).
+CsrGraph loadEdgeList(const string &path)
+{
+    ifstream in(path);
+    if (!in)
+        throw runtime_error("cannot open " + path);
+
+    EdgeList edges;
+    Vertex maxVertex = -1;
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty() || line[0] == '#' || line[0] == '%')
+            continue;
+
+        istringstream fields(line);
+        Vertex u, v;
+        if (fields >> u >> v)
+        {
+            edges.emplace_back(u, v);
+            maxVertex = max({maxVertex, u, v});
+        }
+    }
+
+    return buildCsr(edges, maxVertex + 1);
+}
+
+// stateless 64-bit mixer, so every edge can be generated independently
+inline uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+Bijection on [0, 2^scale), so scrambling vertex ids neither merges vertices nor leaves
+any isolated. Odd multipliers and x ^= x >> s are both invertible modulo 2^scale.
+*/
+Vertex scrambleVertex(Vertex x, int scale, uint64_t seed)
+{
+    const uint64_t mask = (uint64_t(1) << scale) - 1;
+    const uint64_t key = splitMix64(seed);
+    const int shift = max(1, scale / 2);
+
+    uint64_t h = (uint64_t(x) ^ key) & mask;
+    h = (h * 0x9E3779B97F4A7C15ULL) & mask;
+    h ^= h >> shift;
+    h = (h * 0xBF58476D1CE4E5B9ULL) & mask;
+    h ^= h >> shift;
+    return Vertex((h + (key >> 32)) & mask);
+}
+
+/*
+R-MAT generator (Graph500 parameters): each edge picks one quadrant of the adjacency
+matrix per bit with probabilities a, b, c, d, which gives a skewed, power-law-like
+degree distribution. 2^scale vertices and edgeFactor * 2^scale edges.
+Edge e only depends on (seed, e), so the graph is the same for any thread count.
+*/
+EdgeList generateRmat(int scale, int edgeFactor, uint64_t seed = 1)
+{
+    constexpr double A = 0.57, B = 0.19, C = 0.19;
+    const int64_t m = int64_t(edgeFactor) << scale;
+    EdgeList edges(m);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t e = 0; e < m; ++e)
+    {
+        uint64_t state = splitMix64(seed * 0x100000001b3ULL + e);
+        Vertex u = 0, v = 0;
+        for (int bit = 0; bit < scale; ++bit)
+        {
+            state = splitMix64(state);
+            const double r = (state >> 11) * 0x1.0p-53;
+            const int right = (r >= A && r < A + B) || r >= A + B + C;
+            const int down = r >= A + B;
+            u |= down << bit;
+            v |= right << bit;
+        }
+
+        // scramble vertex ids so high-degree vertices are not all at small ids
+        edges[e] = {scrambleVertex(u, scale, seed), scrambleVertex(v, scale, seed)};
+    }
+
+    return edges;
+}
+
+inline bool claimVertex(Vertex &parent, Vertex newParent)
+{
+    Vertex old;
+    #pragma omp atomic compare capture
+    {
+        old = parent;
+        if (parent == -1) { parent = newParent; }
+    }
+    return old == -1;
+}
+
+// adds every vertex in 'frontier' to the bitmap
+void queueToBitmap(const vector<Vertex> &frontier, vector<uint64_t> &bitmap)
+{
+    fill(bitmap.begin(), bitmap.end(), 0);
+
+    const int64_t size = static_cast<int64_t>(frontier.size());
+    #pragma omp parallel for
+    for (int64_t i = 0; i < size; ++i)
+    {
+        const Vertex v = frontier[i];
+        const uint64_t bit = uint64_t(1) << (v & 63);
+        #pragma omp atomic update
+        bitmap[v >> 6] |= bit;
+    }
+}
+
+/*
+Concatenates the per-thread queues into 'out'. Thread t writes at the sum of the
+sizes of queues 0..t-1, so each thread copies its own queue with no locking.
+*/
+void mergeQueues(vector<vector<Vertex>> &local, vector<Vertex> &out)
+{
+    vector<size_t> start(local.size() + 1, 0);
+    for (size_t t = 0; t < local.size(); ++t)
+        start[t + 1] = start[t] + local[t].size();
+
+    out.resize(start.back());
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < static_cast<int>(local.size()); ++t)
+    {
+        copy(local[t].begin(), local[t].end(), out.begin() + start[t]);
+        local[t].clear();
+    }
+}
+
+void bitmapToQueue(const vector<uint64_t> &bitmap, vector<vector<Vertex>> &local, vector<Vertex> &out)
+{
+    const int64_t words = static_cast<int64_t>(bitmap.size());
+
+    #pragma omp parallel
+    {
+        vector<Vertex> &mine = local[omp_get_thread_num()];
+
+        #pragma omp for schedule(static)
+        for (int64_t w = 0; w < words; ++w)
+        {
+            for (uint64_t bits = bitmap[w]; bits != 0; bits &= bits - 1)
+                mine.push_back(Vertex(w * 64 + countr_zero(bits)));
+        }
+    }
+
+    mergeQueues(local, out);
+}
+
+// one top-down level. returns the number of edges checked, for TEPS.
+int64_t topDownStep(const CsrGraph &g, vector<Vertex> &parent, const vector<Vertex> &frontier,
+                    vector<vector<Vertex>> &local, vector<Vertex> &next)
+{
+    const int64_t size = static_cast<int64_t>(frontier.size());
+    int64_t scouted = 0;
+
+    #pragma omp parallel reduction(+ : scouted)
+    {
+        vector<Vertex> &mine = local[omp_get_thread_num()];
+
+        // high-degree vertices make iterations uneven
+        #pragma omp for schedule(dynamic, 64)
+        for (int64_t i = 0; i < size; ++i)
+        {
+            const Vertex u = frontier[i];
+            for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; ++e)
+            {
+                const Vertex v = g.neighbors[e];
+
+                Vertex current;
+                #pragma omp atomic read relaxed
+                current = parent[v];
+
+                // cheap read first so the compare-and-swap only runs on likely winners
+                if (current == -1 && claimVertex(parent[v], u))
+                {
+                    mine.push_back(v);
+                    scouted += g.degree(v);
+                }
+            }
+        }
+    }
+
+    mergeQueues(local, next);
+    return scouted;
+}
+
+// one bottom-up level. returns the number of vertices added to 'next'.
+int64_t bottomUpStep(const CsrGraph &g, vector<Vertex> &parent, const vector<uint64_t> &frontier,
+                     vector<uint64_t> &next)
+{
+    fill(next.begin(), next.end(), 0);
+    int64_t awake = 0;
+
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : awake)
+    for (Vertex v = 0; v < g.numVertices; ++v)
+    {
+        // only this iteration writes parent[v], so no atomics are needed for it
+        if (parent[v] != -1)
+            continue;
+
+        for (int64_t e = g.offsets[v]; e < g.offsets[v + 1]; ++e)
+        {
+            const Vertex u = g.neighbors[e];
+            if (frontier[u >> 6] & (uint64_t(1) << (u & 63)))
+            {
+                parent[v] = u;
+                const uint64_t bit = uint64_t(1) << (v & 63);
+                #pragma omp atomic update
+                next[v >> 6] |= bit;
+                ++awake;
+                break; // the first parent found is enough
+            }
+        }
+    }
+
+    return awake;
+}
+
+// returns parent[] of a BFS tree rooted at 'source'. unreached vertices have parent -1.
+vector<Vertex> parallelBfs(const CsrGraph &g, Vertex source)
+{
+    const Vertex n = g.numVertices;
+    vector<Vertex> parent(n, -1);
+    parent[source] = source;
+
+    vector<vector<Vertex>> local(omp_get_max_threads());
+    vector<Vertex> frontier{source}, nextFrontier;
+    vector<uint64_t> frontierBits((n + 63) / 64), nextBits((n + 63) / 64);
+
+    int64_t edgesToCheck = g.offsets.back();
+    int64_t scouted = g.degree(source);
+
+    while (!frontier.empty())
+    {
+        if (scouted > edgesToCheck / ALPHA)
+        {
+            // bottom-up while the frontier is large
+            queueToBitmap(frontier, frontierBits);
+            int64_t awake = static_cast<int64_t>(frontier.size()), previous;
+            do
+            {
+                previous = awake;
+                awake = bottomUpStep(g, parent, frontierBits, nextBits);
+                swap(frontierBits, nextBits);
+            } while (awake >= previous || awake > n / BETA);
+
+            bitmapToQueue(frontierBits, local, frontier);
+            scouted = 1;
+        }
+        else
+        {
+            edgesToCheck -= scouted;
+            scouted = topDownStep(g, parent, frontier, local, nextFrontier);
+            swap(frontier, nextFrontier);
+        }
+    }
+
+    return parent;
+}
+
+// serial reference: BFS depth of every vertex, -1 if unreached
+vector<int> serialDepths(const CsrGraph &g, Vertex source)
+{
+    vector<int> depth(g.numVertices, -1);
+    vector<Vertex> queue{source};
+    depth[source] = 0;
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        const Vertex u = queue[head];
+        for (int64_t e = g.offsets[u]; e < g.offsets[u + 1]; ++e)
+        {
+            const Vertex v = g.neighbors[e];
+            if (depth[v] == -1)
+            {
+                depth[v] = depth[u] + 1;
+                queue.push_back(v);
+            }
+        }
+    }
+    return depth;
+}
+
+// Graph500-style check: same reached set as a serial BFS and every tree edge goes up exactly one level
+bool validBfsTree(const CsrGraph &g, Vertex source, const vector<Vertex> &parent)
+{
+    const vector<int> depth = serialDepths(g, source);
+    if (parent[source] != source)
+        return false;
+
+    for (Vertex v = 0; v < g.numVertices; ++v)
+    {
+        if ((parent[v] == -1) != (depth[v] == -1))
+            return false;
+        if (v == source || parent[v] == -1)
+            continue;
+        if (depth[parent[v]] != depth[v] - 1)
+            return false;
+
+        auto first = g.neighbors.begin() + g.offsets[v], last = g.neighbors.begin() + g.offsets[v + 1];
+        if (!binary_search(first, last, parent[v]))
+            return false;
+    }
+    return true;
+}
+
+void testBuildCsr()
+{
+    // triangle 0-1-2 plus 2-3, a duplicate edge and a self loop
+    EdgeList edges = {{0, 1}, {1, 2}, {2, 0}, {2, 3}, {3, 2}, {1, 1}};
+    CsrGraph g = buildCsr(edges, 5);
+
+    assert(g.offsets == vector<int64_t>({0, 2, 4, 8, 10, 10}));
+    assert(g.neighbors == vector<Vertex>({1, 2, 0, 2, 0, 1, 3, 3, 2, 2}));
+    assert(g.degree(4) == 0);
+}
+
+void testLoadEdgeList()
+{
+    const string path = (filesystem::temp_directory_path() / "Bfs_test_edges.txt").string();
+    ofstream(path) << "# comment\n0 1\n1 2\n\n2 3\n";
+    CsrGraph g = loadEdgeList(path);
+    remove(path.c_str());
+
+    assert(g.numVertices == 4);
+    vector<Vertex> parent = parallelBfs(g, 0);
+    assert(parent == vector<Vertex>({0, 0, 1, 2}));
+}
+
+void testBfsPath()
+{
+    // a long path forces many top-down levels, a star forces a bottom-up switch
+    const Vertex n = 5000;
+    EdgeList edges;
+    for (Vertex v = 1; v < n / 2; ++v)
+        edges.emplace_back(v - 1, v);
+    for (Vertex v = n / 2 + 1; v < n; ++v)
+        edges.emplace_back(n / 2, v);
+    edges.emplace_back(n / 2 - 1, n / 2);
+
+    CsrGraph g = buildCsr(edges, n + 1); // vertex n is isolated
+    vector<Vertex> parent = parallelBfs(g, 0);
+    assert(validBfsTree(g, 0, parent));
+    assert(parent[n] == -1);
+}
+
+void testScrambleVertex()
+{
+    // every id in [0, 2^scale) is hit exactly once
+    for (int scale : {0, 1, 5, 12})
+    {
+        for (uint64_t seed : {1, 42})
+        {
+            vector<char> seen(size_t(1) << scale, 0);
+            for (Vertex x = 0; x < (Vertex(1) << scale); ++x)
+            {
+                const Vertex y = scrambleVertex(x, scale, seed);
+                assert(y >= 0 && y < (Vertex(1) << scale) && !seen[y]);
+                seen[y] = 1;
+            }
+        }
+    }
+}
+
+void testBfsRmat()
+{
+    CsrGraph g = buildCsr(generateRmat(12, 8), Vertex(1) << 12);
+
+    // the generator does not depend on the thread count
+    const int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    EdgeList serial = generateRmat(10, 4);
+    omp_set_num_threads(threads);
+    assert(serial == generateRmat(10, 4));
+
+    for (Vertex source : {0, 1, 100, 4000})
+        assert(validBfsTree(g, source, parallelBfs(g, source)));
+}
+
+/* Sample output:
+scale  vertices  edges      build s  BFS s     MTEPS
+18     262144    4193572    1.53333  0.0130482   321.386
+19     524288    8387698    3.44938  0.022791    368.021
+20     1048576   16776074   7.03734  0.0413361   405.84
+*/
+void benchmark(int minScale, int maxScale)
+{
+    constexpr int EDGE_FACTOR = 16;
+    constexpr int SEARCHES = 8;
+
+    cout << "scale  vertices  edges      build s  BFS s     MTEPS\n";
+    for (int scale = minScale; scale <= maxScale; ++scale)
+    {
+        auto start = chrono::steady_clock::now();
+        CsrGraph g = buildCsr(generateRmat(scale, EDGE_FACTOR), Vertex(1) << scale);
+        chrono::duration<double> build = chrono::steady_clock::now() - start;
+
+        // Graph500 reports the mean over several roots with at least one edge
+        double totalSeconds = 0.0;
+        double totalEdges = 0.0;
+        for (int s = 0, tries = 0; s < SEARCHES && tries < 100 * SEARCHES; ++tries)
+        {
+            const Vertex source = Vertex(splitMix64(tries) % g.numVertices);
+            if (g.degree(source) == 0)
+                continue;
+
+            start = chrono::steady_clock::now();
+            vector<Vertex> parent = parallelBfs(g, source);
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+            // traversed edges: undirected edges inside the reached component
+            int64_t edges = 0;
+            #pragma omp parallel for reduction(+ : edges)
+            for (Vertex v = 0; v < g.numVertices; ++v)
+            {
+                if (parent[v] != -1)
+                    edges += g.degree(v);
+            }
+
+            totalSeconds += elapsed.count();
+            totalEdges += edges / 2.0;
+            ++s;
+        }
+
+        cout << scale << "\t" << g.numVertices << "\t  " << g.offsets.back() / 2 << "\t     " << build.count()
+             << "\t" << totalSeconds / SEARCHES << "\t" << totalEdges / totalSeconds / 1e6 << '\n';
+    }
+}
+
+void test()
+{
+    testBuildCsr();
+    testLoadEdgeList();
+    testScrambleVertex();
+    testBfsPath();
+    testBfsRmat();
+}
+
+// usage: Bfs [minScale maxScale]. Graph500 sizes are 20..26 (up to 2^26 vertices, ~16 GB).
+int main(int argc, char *argv[])
+{
+    test();
+
+    const int minScale = argc > 2 ? stoi(argv[1]) : 18;
+    const int maxScale = argc > 2 ? stoi(argv[2]) : 20;
+    benchmark(minScale, maxScale);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,447 @@
+/*
+'cancel' stops a parallel loop, parallel region, sections or taskgroup early, for
+example once a search has found its answer.
+https://www.openmp.org/spec-html/5.0/openmpsu99.html
+
+#pragma omp cancel for:                 this thread leaves the loop; the others will too
+#pragma omp cancellation point for:     other threads check for a cancel here
+#pragma omp cancel taskgroup:           tasks of the taskgroup that have not started are
+                                        discarded, running ones stop at a cancellation point
+
+Cancellation is off unless the environment variable OMP_CANCELLATION=true is set
+before the program starts (omp_get_cancellation() reports it). When it is off the
+cancel constructs do nothing, so the code below is still correct but scans everything.
+This program re-runs itself with OMP_CANCELLATION=true when it is not set.
+
+Threads only stop at cancellation points, so loops are split into blocks with one
+cancellation point per block.
+
+Usage: Cancel [elements]
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// the parallel STL needs TBB with libstdc++; MSVC's STL has it built in
+#if defined(WITH_PARALLEL_STL) || defined(_MSVC_STL_VERSION)
+#include <execution>
+#define HAS_PARALLEL_STL 1
+#endif
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// elements between two cancellation points
+constexpr long long BLOCK = 4096;
+
+// index of some element that satisfies pred, or -1
+template <typename T, typename Pred>
+long long parallelAnyOf(const vector<T> &v, Pred pred)
+{
+    const long long n = static_cast<long long>(v.size());
+    const long long blocks = (n + BLOCK - 1) / BLOCK;
+    long long found = -1;
+
+    // not a combined 'parallel for': a cancellable loop cannot be nowait
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(dynamic)
+        for (long long b = 0; b < blocks; ++b)
+        {
+            #pragma omp cancellation point for
+
+            const long long end = min(n, (b + 1) * BLOCK);
+            for (long long i = b * BLOCK; i < end; ++i)
+            {
+                if (pred(v[i]))
+                {
+                    #pragma omp atomic write
+                    found = i;
+
+                    #pragma omp cancel for
+                    break;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+/*
+Index of the first element that satisfies pred, or -1.
+
+A match in block b only answers the question if every block before b has no match.
+Blocks are handed out in increasing order (monotonic), and a thread only checks for
+cancellation between blocks, so the blocks before b that were started are finished.
+Blocks before b that were never started (possible in principle when cancelled early)
+are scanned afterwards.
+*/
+template <typename T, typename Pred>
+long long parallelFindFirst(const vector<T> &v, Pred pred)
+{
+    const long long n = static_cast<long long>(v.size());
+    const long long blocks = (n + BLOCK - 1) / BLOCK;
+    long long first = n;
+    vector<char> done(blocks, 0);
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(monotonic : dynamic)
+        for (long long b = 0; b < blocks; ++b)
+        {
+            #pragma omp cancellation point for
+
+            long long current;
+            #pragma omp atomic read
+            current = first;
+            if (b * BLOCK > current) // cannot beat a match that is already known
+                continue;
+
+            const long long end = min(n, (b + 1) * BLOCK);
+            for (long long i = b * BLOCK; i < end; ++i)
+            {
+                if (pred(v[i]))
+                {
+                    #pragma omp atomic compare
+                    first = i < first ? i : first;
+
+                    done[b] = 1;
+                    #pragma omp cancel for
+                    break;
+                }
+            }
+            done[b] = 1;
+        }
+    }
+
+    for (long long b = 0; b < blocks && b * BLOCK < first; ++b)
+    {
+        if (done[b])
+            continue;
+        const long long end = min(first, (b + 1) * BLOCK);
+        for (long long i = b * BLOCK; i < end; ++i)
+        {
+            if (pred(v[i]))
+            {
+                first = i;
+                break;
+            }
+        }
+    }
+    return first < n ? first : -1;
+}
+
+// baseline: scans everything, then takes the smallest matching index
+template <typename T, typename Pred>
+long long fullScanFindFirst(const vector<T> &v, Pred pred)
+{
+    const long long n = static_cast<long long>(v.size());
+    long long first = n;
+
+    #pragma omp parallel for reduction(min : first)
+    for (long long i = 0; i < n; ++i)
+    {
+        if (pred(v[i]) && i < first)
+            first = i;
+    }
+    return first < n ? first : -1;
+}
+
+template <typename T>
+long long stdFind(const vector<T> &v, const T &value)
+{
+#ifdef HAS_PARALLEL_STL
+    auto it = find(execution::par, v.begin(), v.end(), value);
+#else
+    auto it = find(v.begin(), v.end(), value);
+#endif
+    return it == v.end() ? -1 : it - v.begin();
+}
+
+class TreeNode
+{
+public:
+    int value{};
+    TreeNode *left = nullptr, *right = nullptr;
+
+    TreeNode(int val)
+        : value(val)
+    {
+    }
+};
+
+// subtrees at this depth are searched serially inside one task
+constexpr int TREE_TASK_DEPTH = 10;
+
+// serial depth-first search that gives up once another task has found a match
+TreeNode *serialFind(TreeNode *node, int target, TreeNode *const &found)
+{
+    if (node == nullptr)
+        return nullptr;
+
+    TreeNode *other;
+    #pragma omp atomic read
+    other = found;
+    if (other != nullptr)
+        return nullptr;
+
+    if (node->value == target)
+        return node;
+    TreeNode *hit = serialFind(node->left, target, found);
+    return hit ? hit : serialFind(node->right, target, found);
+}
+
+void _findInTree(TreeNode *node, int target, int depth, TreeNode *&found)
+{
+    if (node == nullptr)
+        return;
+
+    #pragma omp task firstprivate(node, depth) shared(found)
+    {
+        // skip the work if another task already found a match
+        #pragma omp cancellation point taskgroup
+
+        TreeNode *hit = nullptr;
+        if (depth >= TREE_TASK_DEPTH)
+        {
+            hit = serialFind(node, target, found);
+        }
+        else if (node->value == target)
+        {
+            hit = node;
+        }
+        else
+        {
+            _findInTree(node->left, target, depth + 1, found);
+            _findInTree(node->right, target, depth + 1, found);
+        }
+
+        if (hit != nullptr)
+        {
+            #pragma omp atomic write
+            found = hit;
+
+            #pragma omp cancel taskgroup
+        }
+    }
+}
+
+// some node with the target value, or nullptr. tasks still queued are discarded once it is found.
+TreeNode *findInTree(TreeNode *root, int target)
+{
+    TreeNode *found = nullptr;
+
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskgroup
+    _findInTree(root, target, 0, found);
+
+    return found;
+}
+
+// baseline: visits every node
+int countInTree(TreeNode *node, int target, int depth = 0)
+{
+    if (node == nullptr)
+        return 0;
+    if (depth >= TREE_TASK_DEPTH)
+        return (node->value == target) + countInTree(node->left, target, depth) + countInTree(node->right, target, depth);
+
+    int left = 0, right = 0;
+    #pragma omp task shared(left)
+    left = countInTree(node->left, target, depth + 1);
+    #pragma omp task shared(right)
+    right = countInTree(node->right, target, depth + 1);
+    #pragma omp taskwait
+    return (node->value == target) + left + right;
+}
+
+int fullTreeCount(TreeNode *root, int target)
+{
+    int count = 0;
+    #pragma omp parallel
+    #pragma omp single
+    count = countInTree(root, target);
+    return count;
+}
+
+// complete tree with values 0, 1, 2, ... in breadth-first order
+TreeNode *buildTree(int depth, int index = 0)
+{
+    if (depth == 0)
+        return nullptr;
+
+    TreeNode *node = new TreeNode(index);
+    node->left = buildTree(depth - 1, 2 * index + 1);
+    node->right = buildTree(depth - 1, 2 * index + 2);
+    return node;
+}
+
+void deleteTree(TreeNode *node)
+{
+    if (node == nullptr)
+        return;
+    deleteTree(node->left);
+    deleteTree(node->right);
+    delete node;
+}
+
+void testFind()
+{
+    vector<int> v(100'000, 0);
+    auto isOne = [](int x) { return x == 1; };
+
+    assert(parallelFindFirst(v, isOne) == -1);
+    assert(parallelAnyOf(v, isOne) == -1);
+    assert(fullScanFindFirst(v, isOne) == -1);
+
+    // several matches: find first returns the smallest index, any of returns one of them
+    for (long long i : {99'999LL, 70'000LL, 5000LL, 4096LL, 4095LL, 0LL})
+    {
+        v[i] = 1;
+        assert(parallelFindFirst(v, isOne) == i);
+        assert(fullScanFindFirst(v, isOne) == i);
+        assert(stdFind(v, 1) == i);
+
+        const long long any = parallelAnyOf(v, isOne);
+        assert(any >= 0 && v[any] == 1);
+    }
+
+    assert(parallelFindFirst(vector<int>{}, isOne) == -1);
+    assert(parallelAnyOf(vector<int>{}, isOne) == -1);
+}
+
+void testThreadCounts()
+{
+    const int saved = omp_get_max_threads();
+    vector<int> v(50'000, 0);
+    v[12'345] = v[30'000] = v[49'999] = 1;
+
+    for (int threads : {1, 2, 3, 8})
+    {
+        omp_set_num_threads(threads);
+        assert(parallelFindFirst(v, [](int x) { return x == 1; }) == 12'345);
+    }
+    omp_set_num_threads(saved);
+}
+
+void testFindInTree()
+{
+    TreeNode *root = buildTree(16); // values 0 .. 2^16 - 2
+    for (int target : {0, 1, 1000, 40'000, 65'534})
+    {
+        TreeNode *node = findInTree(root, target);
+        assert(node != nullptr && node->value == target);
+        assert(fullTreeCount(root, target) == 1);
+    }
+    assert(findInTree(root, 65'535) == nullptr);
+    assert(findInTree(root, -1) == nullptr);
+    assert(fullTreeCount(root, -1) == 0);
+    deleteTree(root);
+}
+
+template <typename Fn>
+double bestMs(Fn fn)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+/* Sample output (1 core, so the sequential std::find has no threads to wait for):
+67108864 ints, 4 threads, cancellation on
+(std::find is sequential: build with -DWITH_PARALLEL_STL -ltbb for execution::par)
+match at   full scan ms  find first ms  any of ms  std::find ms
+0.001000   65.1862	    0.042529	   0.041254	0.012383
+0.010000   63.3841	    0.399192	   0.268121	0.182937
+0.100000   66.9382	    7.60924	   6.88869	4.99589
+0.500000   65.0889	    33.8755	   33.3813	24.0396
+0.900000   69.8011	    62.0008	   62.5668	45.1089
+none       69.9288	    67.7456	   73.7393	54.1737
+tree of 2^22 nodes   full traversal ms  cancel taskgroup ms
+value 1		27.4804		3.98992
+value 1048576		26.2583		12.3912
+value 4194302		25.4395		0.03826
+value -1		25.9349		31.3729
+*/
+void benchmark(size_t n)
+{
+    vector<int> v(n, 0);
+    auto isOne = [](int x) { return x == 1; };
+    cout << n << " ints, " << omp_get_max_threads() << " threads, cancellation "
+         << (omp_get_cancellation() ? "on" : "off") << "\n";
+#ifndef HAS_PARALLEL_STL
+    cout << "(std::find is sequential: build with -DWITH_PARALLEL_STL -ltbb for execution::par)\n";
+#endif
+    cout << "match at   full scan ms  find first ms  any of ms  std::find ms\n";
+
+    volatile long long sink = 0; // keeps the searches from being optimized away
+    for (double position : {0.001, 0.01, 0.1, 0.5, 0.9, -1.0})
+    {
+        const size_t at = static_cast<size_t>(position * n);
+        if (position >= 0)
+            v[at] = 1;
+
+        cout << (position >= 0 ? to_string(position) : string("none    ")) << "   "
+             << bestMs([&] { sink = fullScanFindFirst(v, isOne); }) << "\t    "
+             << bestMs([&] { sink = parallelFindFirst(v, isOne); }) << "\t   "
+             << bestMs([&] { sink = parallelAnyOf(v, isOne); }) << "\t"
+             << bestMs([&] { sink = stdFind(v, 1); }) << '\n';
+
+        if (position >= 0)
+            v[at] = 0;
+    }
+
+    const int depth = 22;
+    TreeNode *root = buildTree(depth);
+    cout << "tree of 2^" << depth << " nodes   full traversal ms  cancel taskgroup ms\n";
+    for (int target : {1, 1 << 20, (1 << depth) - 2, -1})
+    {
+        cout << "value " << target << "\t\t" << bestMs([&] { fullTreeCount(root, target); }) << "\t\t"
+             << bestMs([&] { findInTree(root, target); }) << '\n';
+    }
+    deleteTree(root);
+}
+
+void test()
+{
+    testFind();
+    testThreadCounts();
+    testFindInTree();
+}
+
+int main(int argc, char *argv[])
+{
+#ifndef _WIN32
+    // the setting is read when the runtime starts, so run again with it set
+    if (!omp_get_cancellation() && getenv("OMP_CANCELLATION") == nullptr)
+    {
+        setenv("OMP_CANCELLATION", "true", 1);
+        execvp(argv[0], argv);
+    }
+#endif
+
+    test();
+    benchmark(argc > 1 ? stoull(argv[1]) : size_t(1) << 26);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,628 @@
+/*
+Parallel checksums of large buffers: CRC32C and an xxHash64 tree hash.
+
+CRC32C (the Castagnoli polynomial, used by iSCSI, ext4, and SSE4.2's crc32 instruction)
+is linear over GF(2), so the CRC of a concatenation follows from the CRCs of its parts:
+    crc(A + B) = crc(A) * x^(8 * |B|) mod P  xor  crc(B)
+Each thread computes the CRC of fixed-size chunks, and the chunk CRCs are combined in
+order with one multiplication each. The digest is exactly the serial CRC.
+https://github.com/madler/zlib/blob/develop/crc32.c (crc32_combine)
+
+XXH64 has no such algebra: its four accumulators run sequentially through the whole
+input. The parallel version is a tree hash: XXH64 of every 1 MB chunk, then XXH64 of the
+chunk digests. Its serial and parallel results are identical for any thread count,
+and inputs of one chunk or less hash to plain XXH64.
+https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+The hardware CRC uses SSE4.2 when the CPU has it (checked at run time).
+
+Usage: Checksum [megabytes] [file]
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_SSE42_CRC
+#include <nmmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// bytes per parallel work item. large enough that combining is free, small enough to balance.
+constexpr size_t CHUNK = size_t(1) << 20;
+
+// read-only view of a whole file. throws if the file cannot be opened or mapped.
+class MappedFile
+{
+public:
+    explicit MappedFile(const string &path)
+    {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw runtime_error("cannot open " + path);
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+            return;
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_ == nullptr)
+            throw runtime_error("cannot map " + path);
+        data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            throw runtime_error("cannot open " + path);
+
+        struct stat st{};
+        fstat(fd_, &st);
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0)
+            return;
+
+        void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED)
+            throw runtime_error("cannot map " + path);
+        data_ = static_cast<const char *>(p);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+#else
+        if (data_)
+            munmap(const_cast<char *>(data_), size_);
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    string_view view() const { return {data_, size_}; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// little-endian loads from any address
+inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// ---------------------------------------------------------------- CRC32C
+
+// reflected Castagnoli polynomial
+constexpr uint32_t CRC32C_POLY = 0x82F63B78;
+
+// slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+constexpr auto CRC32C_TABLE = [] {
+    array<array<uint32_t, 256>, 8> table{};
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        table[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b)
+        for (int k = 1; k < 8; ++k)
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+    return table;
+}();
+
+// the usual calling convention (as zlib's crc32): start from 0, feed the previous result to continue
+uint32_t crc32cSoftware(uint32_t crc, const void *data, size_t length)
+{
+    const auto &t = CRC32C_TABLE;
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint32_t c = ~crc;
+
+    for (; length >= 8; p += 8, length -= 8)
+    {
+        const uint64_t word = read64(p) ^ c;
+        c = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^ t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+            t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^ t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+    }
+    for (; length > 0; ++p, --length)
+        c = (c >> 8) ^ t[0][(c ^ *p) & 0xff];
+
+    return ~c;
+}
+
+// a * b modulo the polynomial, both in reflected bit order (x^0 is the top bit)
+constexpr uint32_t multiplyModP(uint32_t a, uint32_t b)
+{
+    uint32_t product = 0;
+    for (uint32_t m = 1U << 31; m != 0; m >>= 1)
+    {
+        if (a & m)
+            product ^= b;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return product;
+}
+
+/*
+x^(2^k) mod P for k = 0..66, by repeated squaring: enough for a shift by any size_t
+byte count (8 * 2^63 bits). The sequence does not repeat after 32 entries as it does
+for zlib's polynomial: for CRC32C, x^(2^32) mod P is x^2.
+*/
+constexpr auto X_POW_2K = [] {
+    array<uint32_t, 3 + 64> table{};
+    uint32_t p = 1U << 30; // x^1
+    for (size_t k = 0; k < table.size(); ++k)
+    {
+        table[k] = p;
+        p = multiplyModP(p, p);
+    }
+    return table;
+}();
+
+// x^(8 * bytes) mod P: appending 'bytes' zero bytes multiplies a CRC by this
+uint32_t crc32cShift(size_t bytes)
+{
+    uint32_t p = 1U << 31; // x^0
+    for (int k = 3; bytes != 0; bytes >>= 1, ++k)
+    {
+        if (bytes & 1)
+            p = multiplyModP(X_POW_2K[k], p);
+    }
+    return p;
+}
+
+// CRC of A followed by B, from crc(A), crc(B) and the length of B
+uint32_t crc32cCombine(uint32_t crcA, uint32_t crcB, size_t lengthB)
+{
+    return multiplyModP(crc32cShift(lengthB), crcA) ^ crcB;
+}
+
+#ifdef HAVE_SSE42_CRC
+bool hasHardwareCrc()
+{
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+
+// one dependent chain of crc32 instructions on the raw (not inverted) state
+__attribute__((target("sse4.2"))) uint32_t crc32cChain(uint32_t c, const unsigned char *p, size_t length)
+{
+    uint64_t c64 = c;
+    for (; length >= 8; p += 8, length -= 8)
+        c64 = _mm_crc32_u64(c64, read64(p));
+    c = static_cast<uint32_t>(c64);
+    for (; length > 0; ++p, --length)
+        c = _mm_crc32_u8(c, *p);
+    return c;
+}
+
+/*
+The crc32 instruction has a latency of 3 cycles but can start one per cycle, so one
+chain uses a third of it. Long inputs are cut in three parts hashed in the same loop
+and joined with crc32cCombine.
+*/
+__attribute__((target("sse4.2"))) uint32_t crc32cHardware(uint32_t crc, const void *data, size_t length)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    if (length < 3 * 4096)
+        return ~crc32cChain(~crc, p, length);
+
+    const size_t part = length / 3 / 8 * 8;
+    uint64_t c0 = ~crc, c1 = ~0U, c2 = ~0U;
+    for (size_t i = 0; i < part; i += 8)
+    {
+        c0 = _mm_crc32_u64(c0, read64(p + i));
+        c1 = _mm_crc32_u64(c1, read64(p + part + i));
+        c2 = _mm_crc32_u64(c2, read64(p + 2 * part + i));
+    }
+    const uint32_t crc2 = ~crc32cChain(static_cast<uint32_t>(c2), p + 3 * part, length - 3 * part);
+    const uint32_t crc01 = crc32cCombine(~static_cast<uint32_t>(c0), ~static_cast<uint32_t>(c1), part);
+    return crc32cCombine(crc01, crc2, length - 2 * part);
+}
+#else
+bool hasHardwareCrc()
+{
+    return false;
+}
+
+uint32_t crc32cHardware(uint32_t crc, const void *data, size_t length)
+{
+    return crc32cSoftware(crc, data, length);
+}
+#endif
+
+// serial CRC32C with the fastest available implementation
+uint32_t crc32c(const void *data, size_t length)
+{
+    return hasHardwareCrc() ? crc32cHardware(0, data, length) : crc32cSoftware(0, data, length);
+}
+
+// CRC32C of CHUNK-sized pieces on all threads, combined in order into the serial CRC
+uint32_t parallelCrc32c(const void *data, size_t length)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const long long chunks = static_cast<long long>((length + CHUNK - 1) / CHUNK);
+    vector<uint32_t> crcs(chunks);
+    const bool hardware = hasHardwareCrc();
+
+    #pragma omp parallel for schedule(dynamic)
+    for (long long i = 0; i < chunks; ++i)
+    {
+        const size_t begin = i * CHUNK;
+        const size_t size = min(CHUNK, length - begin);
+        crcs[i] = hardware ? crc32cHardware(0, p + begin, size) : crc32cSoftware(0, p + begin, size);
+    }
+
+    // every chunk but the last has the same length, so the same shift
+    const uint32_t shift = crc32cShift(CHUNK);
+    uint32_t crc = 0;
+    for (long long i = 0; i + 1 < chunks; ++i)
+        crc = multiplyModP(shift, crc) ^ crcs[i];
+    if (chunks > 0)
+        crc = crc32cCombine(crc, crcs[chunks - 1], length - (chunks - 1) * CHUNK);
+    return crc;
+}
+
+// ---------------------------------------------------------------- XXH64
+
+constexpr uint64_t XXH_P1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t XXH_P2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t XXH_P3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t XXH_P4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t XXH_P5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_P2;
+    return rotl64(acc, 31) * XXH_P1;
+}
+
+inline uint64_t xxhMerge(uint64_t hash, uint64_t acc)
+{
+    hash ^= xxhRound(0, acc);
+    return hash * XXH_P1 + XXH_P4;
+}
+
+uint64_t xxh64(const void *data, size_t length, uint64_t seed = 0)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const unsigned char *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        uint64_t v1 = seed + XXH_P1 + XXH_P2, v2 = seed + XXH_P2, v3 = seed, v4 = seed - XXH_P1;
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = xxhRound(v1, read64(p));
+            v2 = xxhRound(v2, read64(p + 8));
+            v3 = xxhRound(v3, read64(p + 16));
+            v4 = xxhRound(v4, read64(p + 24));
+        }
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxhMerge(hash, v1);
+        hash = xxhMerge(hash, v2);
+        hash = xxhMerge(hash, v3);
+        hash = xxhMerge(hash, v4);
+    }
+    else
+    {
+        hash = seed + XXH_P5;
+    }
+
+    hash += length;
+    for (; p + 8 <= end; p += 8)
+        hash = rotl64(hash ^ xxhRound(0, read64(p)), 27) * XXH_P1 + XXH_P4;
+    if (p + 4 <= end)
+    {
+        hash = rotl64(hash ^ (read32(p) * XXH_P1), 23) * XXH_P2 + XXH_P3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        hash = rotl64(hash ^ (*p * XXH_P5), 11) * XXH_P1;
+
+    hash ^= hash >> 33;
+    hash *= XXH_P2;
+    hash ^= hash >> 29;
+    hash *= XXH_P3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/*
+XXH64 of the CHUNK digests (little-endian), seeded with the total length so that
+inputs that differ only in how the last chunk is cut still differ. 'parallel'
+only changes who computes the chunk digests, never the result.
+*/
+uint64_t xxh64Tree(const void *data, size_t length, bool parallel = true)
+{
+    if (length <= CHUNK)
+        return xxh64(data, length);
+
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const long long chunks = static_cast<long long>((length + CHUNK - 1) / CHUNK);
+    vector<uint64_t> digests(chunks);
+
+    #pragma omp parallel for schedule(dynamic) if (parallel)
+    for (long long i = 0; i < chunks; ++i)
+    {
+        const size_t begin = i * CHUNK;
+        digests[i] = xxh64(p + begin, min(CHUNK, length - begin));
+    }
+
+    return xxh64(digests.data(), digests.size() * sizeof(uint64_t), length);
+}
+
+// ---------------------------------------------------------------- tests
+
+// deterministic bytes, filled in parallel
+vector<unsigned char> makeBuffer(size_t length, uint64_t seed)
+{
+    vector<unsigned char> buffer(length);
+    const long long words = static_cast<long long>(length / 8);
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < words; ++i)
+    {
+        const uint64_t v = xxhRound(seed, i) * XXH_P3;
+        memcpy(buffer.data() + i * 8, &v, 8);
+    }
+    for (size_t i = words * 8; i < length; ++i)
+        buffer[i] = static_cast<unsigned char>(i * 131 + seed);
+    return buffer;
+}
+
+void testCrc32c()
+{
+    const string digits = "123456789";
+    assert(crc32cSoftware(0, digits.data(), digits.size()) == 0xE3069283);
+    assert(crc32c(digits.data(), digits.size()) == 0xE3069283);
+    assert(crc32c(nullptr, 0) == 0);
+
+    // RFC 3720, appendix B.4
+    unsigned char zeros[32] = {}, ones[32], increasing[32];
+    for (int i = 0; i < 32; ++i)
+    {
+        ones[i] = 0xff;
+        increasing[i] = static_cast<unsigned char>(i);
+    }
+    assert(crc32cSoftware(0, zeros, 32) == 0x8A9136AA);
+    assert(crc32cSoftware(0, ones, 32) == 0x62A8AB43);
+    assert(crc32cSoftware(0, increasing, 32) == 0x46DD794E);
+
+    // incremental calls continue a CRC
+    assert(crc32cSoftware(crc32cSoftware(0, digits.data(), 4), digits.data() + 4, 5) == 0xE3069283);
+}
+
+void testCrc32cCombine()
+{
+    const vector<unsigned char> buffer = makeBuffer(100'003, 7);
+    const uint32_t whole = crc32cSoftware(0, buffer.data(), buffer.size());
+
+    for (size_t split : {size_t(0), size_t(1), size_t(8), size_t(4097), size_t(50'000), buffer.size()})
+    {
+        const uint32_t a = crc32cSoftware(0, buffer.data(), split);
+        const uint32_t b = crc32cSoftware(0, buffer.data() + split, buffer.size() - split);
+        assert(crc32cCombine(a, b, buffer.size() - split) == whole);
+    }
+
+    // B of 2^29 bytes shifts by x^(2^32), past where a 32-entry table would wrap
+    const size_t zeros = size_t(1) << 29;
+    const vector<unsigned char> block(size_t(1) << 20, 0);
+    const uint32_t crcA = crc32cSoftware(0, "abc", 3);
+    uint32_t incremental = crcA, crcB = 0;
+    for (size_t done = 0; done < zeros; done += block.size())
+    {
+        incremental = crc32cSoftware(incremental, block.data(), block.size());
+        crcB = crc32cSoftware(crcB, block.data(), block.size());
+    }
+    assert(crc32cCombine(crcA, crcB, zeros) == incremental);
+
+    // the hardware path (with its three-way split) agrees with the tables
+    if (hasHardwareCrc())
+    {
+        for (size_t length : {size_t(0), size_t(7), size_t(12'287), size_t(12'288), size_t(12'295), buffer.size()})
+            assert(crc32cHardware(0, buffer.data(), length) == crc32cSoftware(0, buffer.data(), length));
+    }
+}
+
+void testParallelCrc32c()
+{
+    const int saved = omp_get_max_threads();
+    for (size_t length : {size_t(0), size_t(5), CHUNK - 1, CHUNK, CHUNK + 1, 5 * CHUNK + 12'345})
+    {
+        const vector<unsigned char> buffer = makeBuffer(length, length);
+        const uint32_t serial = crc32cSoftware(0, buffer.data(), length);
+        for (int threads : {1, 2, 3, 8})
+        {
+            omp_set_num_threads(threads);
+            assert(parallelCrc32c(buffer.data(), length) == serial);
+        }
+    }
+    omp_set_num_threads(saved);
+}
+
+void testXxh64()
+{
+    // reference values from the xxHash project
+    assert(xxh64("", 0) == 0xEF46DB3751D8E999ULL);
+    assert(xxh64("a", 1) == 0xD24EC4F1A98C6E5BULL);
+    assert(xxh64("abc", 3) == 0x44BC2CF5AD770999ULL);
+    const string spam = "Nobody inspects the spammish repetition";
+    assert(xxh64(spam.data(), spam.size()) == 0xFBCEA83C8A378BF1ULL);
+}
+
+void testXxh64Tree()
+{
+    const vector<unsigned char> small = makeBuffer(CHUNK, 1);
+    assert(xxh64Tree(small.data(), small.size()) == xxh64(small.data(), small.size()));
+
+    const int saved = omp_get_max_threads();
+    for (size_t length : {CHUNK + 1, 3 * CHUNK, 7 * CHUNK + 99})
+    {
+        const vector<unsigned char> buffer = makeBuffer(length, 2);
+        const uint64_t serial = xxh64Tree(buffer.data(), length, false);
+        for (int threads : {1, 2, 3, 8})
+        {
+            omp_set_num_threads(threads);
+            assert(xxh64Tree(buffer.data(), length) == serial);
+        }
+        // one flipped bit changes the digest
+        vector<unsigned char> flipped = buffer;
+        flipped[length / 2] ^= 1;
+        assert(xxh64Tree(flipped.data(), length) != serial);
+    }
+    omp_set_num_threads(saved);
+}
+
+// ---------------------------------------------------------------- benchmark
+
+template <typename Fn>
+double bestSeconds(Fn fn)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+void benchmarkBuffer(const char *name, const unsigned char *data, size_t length)
+{
+    const double gb = length / 1e9;
+    volatile uint64_t sink = 0;
+    auto row = [&](const char *label, auto fn) {
+        cout << "  " << label << gb / bestSeconds([&] { sink = fn(); }) << " GB/s\n";
+    };
+
+    cout << name << ", " << length / 1'000'000 << " MB, " << omp_get_max_threads() << " threads\n";
+    row("crc32c tables, serial:    ", [&] { return crc32cSoftware(0, data, length); });
+    if (hasHardwareCrc())
+        row("crc32c sse4.2, serial:    ", [&] { return crc32cHardware(0, data, length); });
+    row("crc32c, parallel:         ", [&] { return parallelCrc32c(data, length); });
+    row("xxh64, serial:            ", [&] { return xxh64(data, length); });
+    row("xxh64 tree, parallel:     ", [&] { return xxh64Tree(data, length); });
+}
+
+/* Sample output (1 core, so parallel matches serial; with more cores it scales to memory bandwidth):
+in memory, 536 MB, 4 threads
+  crc32c tables, serial:    1.15373 GB/s
+  crc32c sse4.2, serial:    9.23031 GB/s
+  crc32c, parallel:         10.052 GB/s
+  xxh64, serial:            4.34905 GB/s
+  xxh64 tree, parallel:     4.25942 GB/s
+mmap, 536 MB, 4 threads
+  crc32c tables, serial:    1.21842 GB/s
+  crc32c sse4.2, serial:    12.2428 GB/s
+  crc32c, parallel:         14.0498 GB/s
+  xxh64, serial:            4.40716 GB/s
+  xxh64 tree, parallel:     4.22842 GB/s
+*/
+void benchmark(size_t megabytes, const string &file)
+{
+    const vector<unsigned char> buffer = makeBuffer(megabytes << 20, 42);
+    benchmarkBuffer("in memory", buffer.data(), buffer.size());
+
+    string path = file;
+    if (path.empty())
+    {
+        path = (filesystem::temp_directory_path() / "Checksum.bin").string();
+        ofstream out(path, ios::binary);
+        out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    }
+    {
+        const MappedFile mapped(path);
+        const string_view view = mapped.view();
+        benchmarkBuffer("mmap", reinterpret_cast<const unsigned char *>(view.data()), view.size());
+
+        if (file.empty())
+            assert(parallelCrc32c(view.data(), view.size()) == crc32c(buffer.data(), buffer.size()));
+        else
+            cout << "crc32c " << hex << parallelCrc32c(view.data(), view.size()) << ", xxh64 tree "
+                 << xxh64Tree(view.data(), view.size()) << dec << '\n';
+    }
+    if (file.empty())
+        filesystem::remove(path);
+}
+
+void test()
+{
+    testCrc32c();
+    testCrc32cCombine();
+    testParallelCrc32c();
+    testXxh64();
+    testXxh64Tree();
+}
+
+int main(int argc, char *argv[])
+{
+    test();
+    benchmark(argc > 1 ? stoull(argv[1]) : 512, argc > 2 ? argv[2] : "");
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,586 @@
+/*
+Parallel CSV parsing into numeric columns, feeding the reductions of Reduction.cpp.
+
+1. The file is memory-mapped (as in WordCount.cpp) and cut into equal byte ranges,
+   one per thread, without looking at the content.
+2. A newline ends a record only outside quotes, and a thread cannot know whether
+   its range starts inside a quoted field. Quote-state speculation: each thread
+   scans its range once and keeps two lists of newlines, those that end a record
+   if the range starts outside quotes and those that do if it starts inside. It
+   also counts its quotes.
+3. A short serial scan over the quote counts gives the real starting state of
+   every range, which selects one of its two lists. No data is scanned twice.
+4. Record counts give each thread the first row it writes, and the threads parse
+   their records straight into the column vectors with std::from_chars.
+
+Fields follow RFC 4180: quoted fields may contain commas, newlines and "" for a
+quote. Fields that are empty or not numbers become NaN. Blank lines are rows of NaN.
+
+Usage: CsvParser [csv file] [--no-header] [column index]...
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+constexpr double MISSING = numeric_limits<double>::quiet_NaN();
+
+// read-only view of a whole file. throws if the file cannot be opened or mapped.
+class MappedFile
+{
+public:
+    explicit MappedFile(const string &path)
+    {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw runtime_error("cannot open " + path);
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+            return;
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_ == nullptr)
+            throw runtime_error("cannot map " + path);
+        data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            throw runtime_error("cannot open " + path);
+
+        struct stat st{};
+        fstat(fd_, &st);
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0)
+            return;
+
+        void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED)
+            throw runtime_error("cannot map " + path);
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(p);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+#else
+        if (data_)
+            munmap(const_cast<char *>(data_), size_);
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    string_view view() const { return {data_, size_}; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+struct CsvColumns
+{
+    vector<string> header;          // names of the parsed columns, if the file has a header
+    vector<vector<double>> columns; // one vector per requested column, all of the same length
+
+    size_t rows() const { return columns.empty() ? 0 : columns[0].size(); }
+};
+
+// a number, or MISSING if the whole field is not one. surrounding spaces are allowed.
+double parseNumber(string_view field)
+{
+    while (!field.empty() && field.front() == ' ')
+        field.remove_prefix(1);
+    while (!field.empty() && field.back() == ' ')
+        field.remove_suffix(1);
+    if (!field.empty() && field.front() == '+') // from_chars does not accept a leading '+'
+        field.remove_prefix(1);
+
+    double value = MISSING;
+    auto [end, error] = from_chars(field.data(), field.data() + field.size(), value);
+    return (error == errc() && end == field.data() + field.size() && !field.empty()) ? value : MISSING;
+}
+
+/*
+Calls onField(index, field) for the fields of one record, without the line ending.
+Quoted fields are passed without their quotes; "" inside them is left as is, which
+only matters for text, and text fields are not numbers anyway.
+*/
+template <typename OnField>
+void forEachField(string_view record, size_t lastField, OnField onField)
+{
+    if (!record.empty() && record.back() == '\r')
+        record.remove_suffix(1);
+
+    size_t field = 0, pos = 0;
+    while (field <= lastField)
+    {
+        string_view value;
+        if (pos < record.size() && record[pos] == '"')
+        {
+            // closing quote: a quote not followed by another quote
+            size_t close = pos + 1;
+            while (close < record.size() && !(record[close] == '"' && (close + 1 == record.size() || record[close + 1] != '"')))
+                close += record[close] == '"' ? 2 : 1;
+            value = record.substr(pos + 1, min(close, record.size()) - pos - 1);
+            pos = record.find(',', close);
+        }
+        else
+        {
+            const size_t comma = record.find(',', pos);
+            value = record.substr(min(pos, record.size()), comma == string_view::npos ? string_view::npos : comma - pos);
+            pos = comma;
+        }
+
+        onField(field, value);
+        if (pos == string_view::npos)
+            return;
+        ++pos;
+        ++field;
+    }
+}
+
+// newlines of one byte range, for both possible quote states at its start
+struct RangeScan
+{
+    vector<size_t> newlinesIfOutside; // record ends if the range starts outside quotes
+    vector<size_t> newlinesIfInside;  // record ends if it starts inside a quoted field
+    bool oddQuotes = false;           // the quote state is flipped at the end of the range
+};
+
+RangeScan scanRange(string_view text, size_t begin, size_t end)
+{
+    RangeScan scan;
+    bool flipped = false; // an odd number of quotes since 'begin'
+    for (size_t i = begin; i < end; ++i)
+    {
+        const char c = text[i];
+        if (c == '"')
+            flipped = !flipped;
+        else if (c == '\n')
+            (flipped ? scan.newlinesIfInside : scan.newlinesIfOutside).push_back(i);
+    }
+    scan.oddQuotes = flipped;
+    return scan;
+}
+
+/*
+Parses the given columns (0-based indexes into each record) of a CSV text. 'ranges'
+is the number of byte ranges scanned in parallel, one per thread by default.
+*/
+CsvColumns parseCsv(string_view text, const vector<size_t> &columnIndexes, bool hasHeader,
+                    int ranges = omp_get_max_threads())
+{
+    const size_t lastField = columnIndexes.empty() ? 0 : *max_element(columnIndexes.begin(), columnIndexes.end());
+    vector<int> slotOf(lastField + 1, -1);
+    for (size_t c = 0; c < columnIndexes.size(); ++c)
+        slotOf[columnIndexes[c]] = static_cast<int>(c);
+
+    ranges = max(1, ranges);
+    vector<RangeScan> scans(ranges);
+    vector<const vector<size_t> *> ends(ranges); // the record ends of each range
+    vector<size_t> firstStart(ranges), firstRow(ranges + 1);
+    CsvColumns result;
+    result.columns.resize(columnIndexes.size());
+    result.header.resize(hasHeader ? columnIndexes.size() : 0);
+
+    #pragma omp parallel
+    {
+        // 1, 2. speculative scan
+        #pragma omp for schedule(static)
+        for (int r = 0; r < ranges; ++r)
+            scans[r] = scanRange(text, text.size() * r / ranges, text.size() * (r + 1) / ranges);
+
+        // 3. resolve the quote state, record starts and the first row of each range
+        #pragma omp single
+        {
+            bool inside = false;
+            size_t start = 0, records = 0;
+            for (int r = 0; r < ranges; ++r)
+            {
+                ends[r] = inside ? &scans[r].newlinesIfInside : &scans[r].newlinesIfOutside;
+                inside = inside != scans[r].oddQuotes;
+
+                firstStart[r] = start;
+                firstRow[r] = records;
+                records += ends[r]->size();
+                if (!ends[r]->empty())
+                    start = ends[r]->back() + 1;
+            }
+
+            // a last record without a trailing newline
+            const bool unterminated = start < text.size();
+            firstRow[ranges] = records + unterminated;
+
+            if (hasHeader && firstRow[ranges] > 0)
+            {
+                // the header is the first record, which may contain quoted newlines too
+                size_t headerEnd = text.size();
+                for (int r = 0; r < ranges && headerEnd == text.size(); ++r)
+                    if (!ends[r]->empty())
+                        headerEnd = ends[r]->front();
+
+                forEachField(text.substr(0, headerEnd), lastField, [&](size_t f, string_view value) {
+                    if (slotOf[f] >= 0)
+                        result.header[slotOf[f]] = string(value);
+                });
+            }
+
+            const size_t rows = firstRow[ranges] - (hasHeader && firstRow[ranges] > 0);
+            for (vector<double> &column : result.columns)
+                column.assign(rows, MISSING);
+        }
+
+        // 4. parse. range r owns the records that end in it (the last one also owns an unterminated record).
+        #pragma omp for schedule(static)
+        for (int r = 0; r < ranges; ++r)
+        {
+            size_t start = firstStart[r];
+            size_t record = firstRow[r];
+            auto parseRecord = [&](size_t end) {
+                if (!(hasHeader && record == 0))
+                {
+                    const size_t row = record - hasHeader;
+                    forEachField(text.substr(start, end - start), lastField, [&](size_t f, string_view value) {
+                        if (slotOf[f] >= 0)
+                            result.columns[slotOf[f]][row] = parseNumber(value);
+                    });
+                }
+                start = end + 1;
+                ++record;
+            };
+
+            for (size_t end : *ends[r])
+                parseRecord(end);
+            if (r == ranges - 1 && record < firstRow[ranges])
+                parseRecord(text.size());
+        }
+    }
+
+    return result;
+}
+
+// sumArray from Reduction.cpp, skipping missing values
+double columnSum(const vector<double> &column)
+{
+    double result = 0.0;
+    const long long n = static_cast<long long>(column.size());
+
+    #pragma omp parallel for reduction(+ : result)
+    for (long long i = 0; i < n; ++i)
+    {
+        if (!isnan(column[i]))
+            result += column[i];
+    }
+    return result;
+}
+
+// maxValue from Reduction.cpp, skipping missing values
+double columnMax(const vector<double> &column)
+{
+    double result = -numeric_limits<double>::infinity();
+    const long long n = static_cast<long long>(column.size());
+
+    #pragma omp parallel for reduction(max : result)
+    for (long long i = 0; i < n; ++i)
+    {
+        if (column[i] > result) // false for NaN
+            result = column[i];
+    }
+    return result;
+}
+
+// baseline: one thread, getline and stod. records must not contain newlines.
+CsvColumns getlineCsv(const string &path, const vector<size_t> &columnIndexes, bool hasHeader)
+{
+    const size_t lastField = *max_element(columnIndexes.begin(), columnIndexes.end());
+    CsvColumns result;
+    result.columns.resize(columnIndexes.size());
+    result.header.resize(hasHeader ? columnIndexes.size() : 0);
+
+    ifstream file(path, ios::binary);
+    string line;
+    bool first = true;
+    while (getline(file, line))
+    {
+        vector<string> fields;
+        forEachField(line, lastField, [&](size_t, string_view value) { fields.emplace_back(value); });
+        fields.resize(lastField + 1);
+
+        for (size_t c = 0; c < columnIndexes.size(); ++c)
+        {
+            const string &field = fields[columnIndexes[c]];
+            if (first && hasHeader)
+            {
+                result.header[c] = field;
+                continue;
+            }
+
+            double value = MISSING;
+            try
+            {
+                size_t used = 0;
+                value = stod(field, &used);
+                if (field.find_first_not_of(' ', used) != string::npos)
+                    value = MISSING;
+            }
+            catch (const logic_error &) // invalid_argument or out_of_range
+            {
+            }
+            result.columns[c].push_back(value);
+        }
+        first = false;
+    }
+    return result;
+}
+
+string writeTempFile(const string &name, const string &contents)
+{
+    string path = (filesystem::temp_directory_path() / name).string();
+    ofstream(path, ios::binary) << contents;
+    return path;
+}
+
+// equal including NaN in the same places
+bool sameColumns(const CsvColumns &a, const CsvColumns &b)
+{
+    if (a.header != b.header || a.columns.size() != b.columns.size())
+        return false;
+    for (size_t c = 0; c < a.columns.size(); ++c)
+    {
+        if (a.columns[c].size() != b.columns[c].size())
+            return false;
+        for (size_t i = 0; i < a.columns[c].size(); ++i)
+        {
+            const double x = a.columns[c][i], y = b.columns[c][i];
+            if (!(x == y || (isnan(x) && isnan(y))))
+                return false;
+        }
+    }
+    return true;
+}
+
+void testParseNumber()
+{
+    assert(parseNumber("1.5") == 1.5);
+    assert(parseNumber(" -2e3 ") == -2000.0);
+    assert(parseNumber("+7") == 7.0);
+    assert(isnan(parseNumber("")));
+    assert(isnan(parseNumber("abc")));
+    assert(isnan(parseNumber("12abc")));
+}
+
+void testParseCsv()
+{
+    const string text =
+        "id,name,price,qty\r\n"
+        "1,\"apple, red\",1.25,3\r\n"
+        "2,\"multi\nline \"\"quoted\"\" name\",2.5,\r\n"
+        "3,pear,n/a,7\n"
+        "\n"
+        "4,\"kiwi\",\"4\",1"; // no trailing newline
+
+    for (int ranges : {1, 2, 3, 5, 16, 200})
+    {
+        CsvColumns csv = parseCsv(text, {0, 2, 3}, true, ranges);
+        assert((csv.header == vector<string>{"id", "price", "qty"}));
+        assert(csv.rows() == 5);
+
+        const vector<double> &id = csv.columns[0], &price = csv.columns[1], &qty = csv.columns[2];
+        assert(id[0] == 1 && price[0] == 1.25 && qty[0] == 3);
+        assert(id[1] == 2 && price[1] == 2.5 && isnan(qty[1])); // newline and comma inside quotes
+        assert(id[2] == 3 && isnan(price[2]) && qty[2] == 7);
+        assert(isnan(id[3]) && isnan(price[3]) && isnan(qty[3])); // blank line
+        assert(id[4] == 4 && price[4] == 4 && qty[4] == 1);
+
+        assert(columnSum(price) == 7.75);
+        assert(columnMax(qty) == 7);
+    }
+
+    assert(parseCsv("", {0}, true).rows() == 0);
+    assert(parseCsv("5\n6\n", {0}, false).rows() == 2);
+}
+
+// rows of: id, x, "name, with comma", optional multi-line note, value
+string generateCsv(size_t bytes, bool multiLine)
+{
+    mt19937 rng(7);
+    uniform_real_distribution<double> uniform(-1000.0, 1000.0);
+
+    string text = "id,x,name,note,value\n";
+    text.reserve(bytes + 256);
+    char number[64];
+    for (long long id = 0; text.size() < bytes; ++id)
+    {
+        text += to_string(id);
+        snprintf(number, sizeof(number), ",%.6f,", uniform(rng));
+        text += number;
+        text += "\"item " + to_string(id % 1000) + ", size " + to_string(id % 7) + "\",";
+        if (multiLine && id % 5 == 0)
+            text += "\"line one\nline \"\"two\"\"\"";
+        snprintf(number, sizeof(number), ",%.3f\n", uniform(rng));
+        text += number;
+    }
+    return text;
+}
+
+void testSpeculation()
+{
+    // many quoted newlines, so range boundaries often fall inside quotes
+    const string text = generateCsv(200'000, true);
+    const CsvColumns reference = parseCsv(text, {0, 1, 4}, true, 1);
+    assert(reference.rows() > 1000);
+
+    for (int ranges : {2, 3, 4, 7, 64, 1000})
+        assert(sameColumns(parseCsv(text, {0, 1, 4}, true, ranges), reference));
+
+    // ids are consecutive, so every record was split correctly
+    for (size_t i = 0; i < reference.rows(); ++i)
+        assert(reference.columns[0][i] == double(i));
+}
+
+void testGetlineBaseline()
+{
+    const string text = generateCsv(100'000, false);
+    const string path = writeTempFile("CsvParser_test.csv", text);
+    {
+        MappedFile file(path);
+        assert(sameColumns(parseCsv(file.view(), {1, 4}, true), getlineCsv(path, {1, 4}, true)));
+    }
+    filesystem::remove(path);
+}
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output (1 core, so the speedup is from from_chars and the mapping, not threads):
+Input: 134 MB, 4 threads
+  getline + stod (1 thread): 0.117786 GB/s
+  parallel + from_chars:     0.325868 GB/s
+  x: sum 43657.5, max 999.999
+  value: sum 1.8317e+06, max 999.999
+*/
+/*
+Returns whether both parsers agree. The getline baseline splits on every newline, so a
+valid file with newlines inside quoted fields is expected to differ: that is reported,
+not asserted.
+*/
+bool benchmark(const string &path, const vector<size_t> &columnIndexes, bool hasHeader)
+{
+    MappedFile file(path);
+    const double gb = file.view().size() / 1e9;
+    cout << "Input: " << file.view().size() / 1'000'000 << " MB, " << omp_get_max_threads() << " threads\n";
+
+    CsvColumns parallel, serial;
+    const double parallelSeconds = secondsFor([&] { parallel = parseCsv(file.view(), columnIndexes, hasHeader); });
+    const double serialSeconds = secondsFor([&] { serial = getlineCsv(path, columnIndexes, hasHeader); });
+    const bool same = sameColumns(parallel, serial);
+
+    cout << "  getline + stod (1 thread): " << gb / serialSeconds << " GB/s\n";
+    cout << "  parallel + from_chars:     " << gb / parallelSeconds << " GB/s\n";
+
+    for (size_t c = 0; c < columnIndexes.size(); ++c)
+    {
+        const string name = hasHeader ? parallel.header[c] : "column " + to_string(columnIndexes[c]);
+        cout << "  " << name << ": sum " << columnSum(parallel.columns[c]) << ", max " << columnMax(parallel.columns[c]) << '\n';
+    }
+
+    if (!same)
+        cout << "  (the getline baseline differs: it splits quoted fields that contain newlines)\n";
+    return same;
+}
+
+void test()
+{
+    testParseNumber();
+    testParseCsv();
+    testSpeculation();
+    testGetlineBaseline();
+}
+
+// without a file, a 128 MB sample file is generated and columns x and value are parsed
+int main(int argc, char *argv[])
+{
+    test();
+
+    if (argc > 1)
+    {
+        int arg = 2;
+        const bool hasHeader = !(argc > arg && string(argv[arg]) == "--no-header");
+        if (!hasHeader)
+            ++arg;
+
+        vector<size_t> columnIndexes;
+        for (; arg < argc; ++arg)
+            columnIndexes.push_back(stoull(argv[arg]));
+        if (columnIndexes.empty())
+            columnIndexes.push_back(0);
+        benchmark(argv[1], columnIndexes, hasHeader);
+    }
+    else
+    {
+        // the generated file has no quoted newlines, so both parsers must agree
+        const string path = writeTempFile("CsvParser_bench.csv", generateCsv(size_t(128) << 20, false));
+        [[maybe_unused]] const bool same = benchmark(path, {1, 4}, true);
+        filesystem::remove(path);
+        assert(same);
+    }
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+Parallel distinct (deduplication) of 64-bit keys by radix partitioning.
+
+Inserting into one std::unordered_set from many threads needs a critical section
+around every insert, so the threads take turns. Instead:
+1. histogram: each thread counts how many of its keys fall in each partition.
+   The partition is the top bits of the key's hash.
+2. scan:      an exclusive prefix sum over (partition, thread) gives every thread
+   its own write offset in every partition.
+3. scatter:   each thread copies its keys to their partitions. No two threads
+   write to the same place, so no locking is needed.
+4. build:     equal keys are always in the same partition, so every partition is
+   deduplicated on its own with a small open-addressing hash table. Partitions
+   are independent and small enough to stay in cache.
+
+Usage: Dedupe [keys] [distinct keys]
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// 2^PARTITION_BITS partitions. 10^8 keys give about 10^5 keys (a 2 MB table) per partition.
+constexpr int PARTITION_BITS = 10;
+constexpr size_t PARTITIONS = size_t(1) << PARTITION_BITS;
+
+// marks an empty slot in the open-addressing tables. the key itself is tracked separately.
+constexpr uint64_t EMPTY = ~0ULL;
+
+inline uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+inline size_t partitionOf(uint64_t hash)
+{
+    return hash >> (64 - PARTITION_BITS);
+}
+
+/*
+Distinct keys of one partition, appended to 'out'. Linear probing on the low hash
+bits (the top bits are the same for every key of the partition). 'table' is reused
+between partitions to avoid allocating.
+*/
+void distinctPartition(const uint64_t *keys, size_t count, vector<uint64_t> &table, vector<uint64_t> &out)
+{
+    size_t capacity = 16;
+    while (capacity < 2 * count) // load factor at most 1/2
+        capacity *= 2;
+    table.assign(capacity, EMPTY);
+    const size_t mask = capacity - 1;
+
+    bool sawEmptyKey = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t key = keys[i];
+        if (key == EMPTY)
+        {
+            if (!sawEmptyKey)
+                out.push_back(key);
+            sawEmptyKey = true;
+            continue;
+        }
+
+        size_t slot = splitMix64(key) & mask;
+        while (table[slot] != EMPTY && table[slot] != key)
+            slot = (slot + 1) & mask;
+
+        if (table[slot] == EMPTY)
+        {
+            table[slot] = key;
+            out.push_back(key);
+        }
+    }
+}
+
+// distinct keys, in no particular order
+vector<uint64_t> parallelDistinct(const vector<uint64_t> &keys)
+{
+    const size_t n = keys.size();
+    vector<uint64_t> partitioned(n);
+    vector<size_t> partitionStart(PARTITIONS + 1, 0);
+    vector<vector<uint64_t>> distinct(PARTITIONS);
+
+    // offsets[p * threads + t]: where thread t writes its keys of partition p
+    vector<size_t> offsets(PARTITIONS * omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        const int threads = omp_get_num_threads();
+        const int thread = omp_get_thread_num();
+
+        // fixed contiguous range per thread, the same in the histogram and scatter passes
+        const size_t begin = n * thread / threads;
+        const size_t end = n * (thread + 1) / threads;
+
+        // 1. histogram
+        vector<size_t> counts(PARTITIONS, 0);
+        for (size_t i = begin; i < end; ++i)
+            ++counts[partitionOf(splitMix64(keys[i]))];
+        for (size_t p = 0; p < PARTITIONS; ++p)
+            offsets[p * threads + thread] = counts[p];
+
+        // 2. exclusive scan in (partition, thread) order
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t sum = 0;
+            for (size_t p = 0; p < PARTITIONS; ++p)
+            {
+                partitionStart[p] = sum;
+                for (int t = 0; t < threads; ++t)
+                {
+                    const size_t count = offsets[p * threads + t];
+                    offsets[p * threads + t] = sum;
+                    sum += count;
+                }
+            }
+            partitionStart[PARTITIONS] = sum;
+        }
+
+        // 3. scatter
+        vector<size_t> next(PARTITIONS);
+        for (size_t p = 0; p < PARTITIONS; ++p)
+            next[p] = offsets[p * threads + thread];
+        for (size_t i = begin; i < end; ++i)
+            partitioned[next[partitionOf(splitMix64(keys[i]))]++] = keys[i];
+
+        // 4. one table per partition. partitions are unevenly sized, so dynamic.
+        #pragma omp barrier
+        vector<uint64_t> table;
+        #pragma omp for schedule(dynamic)
+        for (size_t p = 0; p < PARTITIONS; ++p)
+            distinctPartition(partitioned.data() + partitionStart[p],
+                              partitionStart[p + 1] - partitionStart[p], table, distinct[p]);
+    }
+
+    // concatenate the partitions
+    vector<size_t> outStart(PARTITIONS + 1, 0);
+    for (size_t p = 0; p < PARTITIONS; ++p)
+        outStart[p + 1] = outStart[p] + distinct[p].size();
+
+    vector<uint64_t> result(outStart[PARTITIONS]);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t p = 0; p < PARTITIONS; ++p)
+        copy(distinct[p].begin(), distinct[p].end(), result.begin() + outStart[p]);
+
+    return result;
+}
+
+// baseline: one shared set behind a critical section
+vector<uint64_t> criticalDistinct(const vector<uint64_t> &keys)
+{
+    unordered_set<uint64_t> seen;
+    const long long n = static_cast<long long>(keys.size());
+
+    #pragma omp parallel for
+    for (long long i = 0; i < n; ++i)
+    {
+        #pragma omp critical(seenSet)
+        seen.insert(keys[i]);
+    }
+
+    return vector<uint64_t>(seen.begin(), seen.end());
+}
+
+// baseline: sort and unique (serial)
+vector<uint64_t> sortUniqueDistinct(vector<uint64_t> keys)
+{
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// n keys drawn from 'distinct' different values
+vector<uint64_t> randomKeys(size_t n, uint64_t distinct, uint64_t seed)
+{
+    assert(distinct > 0);
+    vector<uint64_t> keys(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i)
+        keys[i] = splitMix64(splitMix64(seed + i) % distinct); // scattered values, few of them
+    return keys;
+}
+
+vector<uint64_t> sorted(vector<uint64_t> keys)
+{
+    sort(keys.begin(), keys.end());
+    return keys;
+}
+
+void testParallelDistinct()
+{
+    assert(parallelDistinct({}).empty());
+    assert(sorted(parallelDistinct({5, 5, 5})) == vector<uint64_t>{5});
+
+    // the sentinel value and zero are ordinary keys
+    assert(sorted(parallelDistinct({EMPTY, 0, EMPTY, 0, 1})) == (vector<uint64_t>{0, 1, EMPTY}));
+
+    for (uint64_t distinct : {1ULL, 1000ULL, 100'000ULL, ~0ULL})
+    {
+        const vector<uint64_t> keys = randomKeys(200'000, distinct, distinct);
+        const vector<uint64_t> expected = sortUniqueDistinct(keys);
+        assert(sorted(parallelDistinct(keys)) == expected);
+        assert(sorted(criticalDistinct(keys)) == expected);
+    }
+}
+
+void testThreadCounts()
+{
+    const int saved = omp_get_max_threads();
+    const vector<uint64_t> keys = randomKeys(50'000, 20'000, 3);
+    const vector<uint64_t> expected = sortUniqueDistinct(keys);
+
+    for (int threads : {1, 2, 3, 7})
+    {
+        omp_set_num_threads(threads);
+        assert(sorted(parallelDistinct(keys)) == expected);
+    }
+    omp_set_num_threads(saved);
+}
+
+template <typename Fn>
+double seconds(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output (1 core):
+16777216 keys, about 4194304 distinct, 4 threads
+radix partitioned:      607.433 ms, 27.6199 Mkeys/s, 4117553 distinct
+sort + unique:          1774.94 ms, 9.4523 Mkeys/s, 4117553 distinct
+unordered_set critical: 7775.59 ms, 2.15768 Mkeys/s, 4117553 distinct
+*/
+void benchmark(size_t n, uint64_t distinct)
+{
+    const vector<uint64_t> keys = randomKeys(n, distinct, 1);
+    cout << n << " keys, about " << distinct << " distinct, " << omp_get_max_threads() << " threads\n";
+
+    size_t count = 0;
+    auto row = [&](const char *name, auto fn) {
+        const double s = seconds([&] { count = fn().size(); });
+        cout << name << s * 1e3 << " ms, " << n / s / 1e6 << " Mkeys/s, " << count << " distinct\n";
+    };
+
+    row("radix partitioned:      ", [&] { return parallelDistinct(keys); });
+    row("sort + unique:          ", [&] { return sortUniqueDistinct(keys); });
+    row("unordered_set critical: ", [&] { return criticalDistinct(keys); });
+}
+
+void test()
+{
+    testParallelDistinct();
+    testThreadCounts();
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t n = argc > 1 ? stoull(argv[1]) : size_t(1) << 24;
+    // at least one distinct value: randomKeys divides by it
+    const uint64_t distinct = max<uint64_t>(1, argc > 2 ? stoull(argv[2]) : n / 4);
+
+    test();
+    benchmark(n, distinct);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
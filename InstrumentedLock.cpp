@@ -0,0 +1,586 @@
+/*
+Instrumented locks: how long do threads wait for a critical section?
+
+'#pragma omp critical' and omp_lock_t show nothing about contention. InstrumentedLock
+wraps omp_lock_t and records, per lock name:
+- acquisitions and contended acquisitions (the lock was already held)
+- a histogram of wait times (contended acquisitions only)
+- a histogram of hold times
+
+All statistics are updated while the lock is held, so they need no atomics. The
+uncontended path is one omp_test_lock and a counter increment. Hold times are read
+from the time stamp counter for every contended acquisition and for 1 in
+HOLD_SAMPLE_RATE uncontended ones, which keeps the uncontended overhead to a few ns.
+
+INSTRUMENTED_CRITICAL(name) replaces '#pragma omp critical(name)'. Like named
+critical sections, every use of the same name shares one lock:
+
+INSTRUMENTED_CRITICAL(sum)
+{
+    sharedSum += computedValue;
+}
+
+A contention report for every lock name is printed to stderr at exit.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_RDTSC 1
+#elif defined(_M_X64)
+#include <intrin.h>
+#define HAS_RDTSC 1
+#endif
+
+using namespace std;
+
+// 1 in HOLD_SAMPLE_RATE uncontended acquisitions measures its hold time. must be a power of two.
+constexpr uint64_t HOLD_SAMPLE_RATE = 64;
+
+// cheap timestamp. the time stamp counter where available, otherwise steady_clock nanoseconds.
+inline uint64_t ticks()
+{
+#ifdef HAS_RDTSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// ticks per nanosecond, measured once against steady_clock
+double ticksPerNs()
+{
+    static const double rate = [] {
+#ifdef HAS_RDTSC
+        auto start = chrono::steady_clock::now();
+        uint64_t t0 = ticks();
+        this_thread::sleep_for(chrono::milliseconds(20));
+        uint64_t t1 = ticks();
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+        return (t1 - t0) / elapsed.count();
+#else
+        return 1.0;
+#endif
+    }();
+    return rate;
+}
+
+// bucket b counts durations in [2^(b-1), 2^b) ticks; bucket 0 counts zero
+struct Histogram
+{
+    array<uint64_t, 65> buckets{};
+
+    void add(uint64_t duration)
+    {
+        int b = 0;
+        while (duration >> b)
+            ++b;
+        ++buckets[b];
+    }
+
+    void merge(const Histogram &other)
+    {
+        for (size_t b = 0; b < buckets.size(); ++b)
+            buckets[b] += other.buckets[b];
+    }
+
+    uint64_t count() const
+    {
+        uint64_t n = 0;
+        for (uint64_t c : buckets)
+            n += c;
+        return n;
+    }
+
+    // upper bound (in ticks) of the bucket holding the given fraction of samples
+    uint64_t percentile(double fraction) const
+    {
+        const uint64_t target = static_cast<uint64_t>(fraction * count());
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b)
+        {
+            seen += buckets[b];
+            if (seen > target)
+                return b == 0 ? 0 : (b >= 64 ? UINT64_MAX : (uint64_t(1) << b));
+        }
+        return 0;
+    }
+};
+
+struct LockStats
+{
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    uint64_t totalWait = 0; // ticks
+    Histogram wait;
+    Histogram hold; // sampled
+
+    void merge(const LockStats &other)
+    {
+        acquisitions += other.acquisitions;
+        contended += other.contended;
+        totalWait += other.totalWait;
+        wait.merge(other.wait);
+        hold.merge(other.hold);
+    }
+};
+
+string formatNs(uint64_t tickCount)
+{
+    const double ns = tickCount / ticksPerNs();
+    ostringstream out;
+    out << fixed << setprecision(0);
+    if (ns < 1e3)
+        out << ns << " ns";
+    else if (ns < 1e6)
+        out << ns / 1e3 << " us";
+    else
+        out << ns / 1e6 << " ms";
+    return out.str();
+}
+
+void printStats(ostream &out, const string &name, const LockStats &s)
+{
+    if (s.acquisitions == 0)
+        return;
+
+    out << name << ": " << s.acquisitions << " acquisitions, " << s.contended << " contended ("
+        << fixed << setprecision(1) << 100.0 * s.contended / s.acquisitions << "%)" << defaultfloat << '\n';
+    if (s.contended > 0)
+    {
+        out << "  wait: total " << formatNs(s.totalWait) << ", p50 < " << formatNs(s.wait.percentile(0.5))
+            << ", p99 < " << formatNs(s.wait.percentile(0.99)) << '\n';
+    }
+    if (s.hold.count() > 0)
+    {
+        out << "  hold (" << s.hold.count() << " samples): p50 < " << formatNs(s.hold.percentile(0.5))
+            << ", p99 < " << formatNs(s.hold.percentile(0.99)) << '\n';
+    }
+}
+
+class InstrumentedLock;
+
+// all locks by name. prints the contention report when the program exits.
+class LockRegistry
+{
+public:
+    static LockRegistry &instance()
+    {
+        static LockRegistry registry;
+        return registry;
+    }
+
+    ~LockRegistry()
+    {
+        if (!retired_.empty() || !live_.empty())
+        {
+            cerr << "\nLock contention report:\n";
+            report(cerr);
+        }
+    }
+
+    void add(InstrumentedLock *lock)
+    {
+        #pragma omp critical(lockRegistry)
+        live_.push_back(lock);
+    }
+
+    // keeps the statistics of a destroyed lock for the report
+    void remove(InstrumentedLock *lock, const string &name, const LockStats &stats)
+    {
+        #pragma omp critical(lockRegistry)
+        {
+            live_.erase(find(live_.begin(), live_.end(), lock));
+            retired_[name].merge(stats);
+        }
+    }
+
+    // statistics of every lock with this name, live or destroyed
+    LockStats stats(const string &name);
+
+    void report(ostream &out);
+
+    // the shared lock behind INSTRUMENTED_CRITICAL(name)
+    InstrumentedLock &named(const string &name);
+
+private:
+    LockRegistry() = default;
+
+    vector<InstrumentedLock *> live_;
+    map<string, LockStats> retired_;
+    map<string, InstrumentedLock *> named_;
+};
+
+class InstrumentedLock
+{
+public:
+    explicit InstrumentedLock(string name)
+        : name_(std::move(name))
+    {
+        omp_init_lock(&lock_);
+        LockRegistry::instance().add(this);
+    }
+
+    ~InstrumentedLock()
+    {
+        LockRegistry::instance().remove(this, name_, stats_);
+        omp_destroy_lock(&lock_);
+    }
+
+    InstrumentedLock(const InstrumentedLock &) = delete;
+    InstrumentedLock &operator=(const InstrumentedLock &) = delete;
+
+    void lock()
+    {
+        if (omp_test_lock(&lock_))
+        {
+            // fast path: nobody held the lock
+            const uint64_t n = ++stats_.acquisitions;
+            holdStart_ = (n & (HOLD_SAMPLE_RATE - 1)) == 0 ? ticks() : 0;
+            return;
+        }
+
+        const uint64_t start = ticks();
+        omp_set_lock(&lock_);
+        const uint64_t acquired = ticks();
+
+        ++stats_.acquisitions;
+        ++stats_.contended;
+        stats_.totalWait += acquired - start;
+        stats_.wait.add(acquired - start);
+        holdStart_ = acquired;
+    }
+
+    void unlock()
+    {
+        if (holdStart_ != 0)
+            stats_.hold.add(ticks() - holdStart_);
+        omp_unset_lock(&lock_);
+    }
+
+    const string &name() const { return name_; }
+
+    // only consistent while no other thread uses the lock
+    const LockStats &stats() const { return stats_; }
+
+    class Guard
+    {
+    public:
+        explicit Guard(InstrumentedLock &lock)
+            : lock_(lock)
+        {
+            lock_.lock();
+        }
+
+        ~Guard() { lock_.unlock(); }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        InstrumentedLock &lock_;
+    };
+
+private:
+    omp_lock_t lock_;
+    const string name_;
+    LockStats stats_; // only modified by the thread holding lock_
+    uint64_t holdStart_ = 0;
+};
+
+LockStats LockRegistry::stats(const string &name)
+{
+    LockStats total;
+    #pragma omp critical(lockRegistry)
+    {
+        if (retired_.count(name))
+            total.merge(retired_[name]);
+        for (InstrumentedLock *lock : live_)
+        {
+            if (lock->name() == name)
+                total.merge(lock->stats());
+        }
+    }
+    return total;
+}
+
+void LockRegistry::report(ostream &out)
+{
+    map<string, LockStats> byName;
+    #pragma omp critical(lockRegistry)
+    {
+        byName = retired_;
+        for (InstrumentedLock *lock : live_)
+            byName[lock->name()].merge(lock->stats());
+    }
+
+    for (const auto &[name, stats] : byName)
+        printStats(out, name, stats);
+}
+
+InstrumentedLock &LockRegistry::named(const string &name)
+{
+    InstrumentedLock *lock = nullptr;
+    #pragma omp critical(lockRegistry)
+    lock = named_[name];
+
+    if (lock == nullptr)
+    {
+        // never destroyed: named locks live until the registry prints its report
+        InstrumentedLock *created = new InstrumentedLock(name);
+        #pragma omp critical(lockRegistry)
+        {
+            if (named_[name] == nullptr)
+                named_[name] = created;
+            lock = named_[name];
+        }
+        if (lock != created)
+            delete created;
+    }
+    return *lock;
+}
+
+/*
+drop-in for '#pragma omp critical(name)'. the lock is looked up once per call site,
+in a static inside the lambda. one statement, so it works as the body of a braceless
+loop or if, and the empty then-branch keeps a following 'else' bound to the outer if.
+*/
+#define INSTRUMENTED_CRITICAL(name)                                                     \
+    if (InstrumentedLock::Guard instrumentedGuard_##name{[]() -> InstrumentedLock & {   \
+            static InstrumentedLock &lock = LockRegistry::instance().named(#name);      \
+            return lock;                                                                \
+        }()};                                                                           \
+        false) {}                                                                       \
+    else
+
+void testUncontended()
+{
+    InstrumentedLock lock("testUncontended");
+    for (int i = 0; i < 1000; ++i)
+    {
+        lock.lock();
+        lock.unlock();
+    }
+
+    assert(lock.stats().acquisitions == 1000);
+    assert(lock.stats().contended == 0);
+    assert(lock.stats().wait.count() == 0);
+    assert(lock.stats().hold.count() == 1000 / HOLD_SAMPLE_RATE);
+}
+
+void testContended()
+{
+    InstrumentedLock lock("testContended");
+    int team = 0;
+
+    #pragma omp parallel num_threads(4)
+    {
+        #pragma omp single
+        team = omp_get_num_threads();
+
+        // thread 0 holds the lock while the others try to take it
+        if (omp_get_thread_num() == 0)
+            lock.lock();
+
+        #pragma omp barrier
+
+        if (omp_get_thread_num() == 0)
+        {
+            this_thread::sleep_for(chrono::milliseconds(50));
+            lock.unlock();
+        }
+        else
+        {
+            lock.lock();
+            lock.unlock();
+        }
+    }
+
+    assert(lock.stats().acquisitions == uint64_t(team));
+    assert(lock.stats().contended == uint64_t(team - 1));
+    assert(lock.stats().wait.count() == uint64_t(team - 1));
+    assert(lock.stats().hold.count() >= uint64_t(team - 1)); // every contended hold is timed
+}
+
+void testNamedCritical()
+{
+    int sharedSum = 0;
+
+    #pragma omp parallel for
+    for (int i = 0; i < 101; ++i)
+    {
+        INSTRUMENTED_CRITICAL(testNamedCritical)
+        {
+            sharedSum += i;
+        }
+    }
+
+    assert(sharedSum == 5050);
+    assert(LockRegistry::instance().stats("testNamedCritical").acquisitions == 101);
+
+    // the same name anywhere else shares the lock
+    INSTRUMENTED_CRITICAL(testNamedCritical)
+    {
+        sharedSum = 0;
+    }
+    assert(LockRegistry::instance().stats("testNamedCritical").acquisitions == 102);
+
+    // one statement: a braceless loop body, and twice in the same block
+    for (int i = 0; i < 3; ++i)
+        INSTRUMENTED_CRITICAL(testNamedCritical) sharedSum += i;
+    INSTRUMENTED_CRITICAL(testNamedCritical) ++sharedSum;
+    INSTRUMENTED_CRITICAL(testNamedCritical) ++sharedSum;
+    assert(sharedSum == 5);
+    assert(LockRegistry::instance().stats("testNamedCritical").acquisitions == 107);
+
+    // an 'else' after it still belongs to the outer if
+    if (sharedSum < 0)
+        INSTRUMENTED_CRITICAL(testNamedCritical) sharedSum = 0;
+    else
+        sharedSum = -1;
+    assert(sharedSum == -1);
+}
+
+void testRetiredStats()
+{
+    {
+        InstrumentedLock lock("testRetired");
+        lock.lock();
+        lock.unlock();
+    }
+
+    // statistics outlive the lock
+    assert(LockRegistry::instance().stats("testRetired").acquisitions == 1);
+}
+
+void testHistogram()
+{
+    Histogram h;
+    h.add(0);
+    h.add(1);
+    h.add(3);
+    h.add(1000);
+    assert(h.count() == 4);
+    assert(h.buckets[0] == 1 && h.buckets[1] == 1 && h.buckets[2] == 1 && h.buckets[10] == 1);
+    assert(h.percentile(0.99) == 1024);
+}
+
+/* Sample output (stdout and stderr; the report at exit lists every lock the program
+created, including the ones in the tests):
+uncontended lock + unlock, 10000000 times:
+  omp_lock_t:       19.2 ns
+  InstrumentedLock: 18.6 ns (-0.6 ns)
+contended sum, 4 threads, 1000000 iterations:
+  omp critical:          18.6 ms
+  INSTRUMENTED_CRITICAL: 20.6 ms
+
+InstrumentedLock.cpp tests passed!
+
+Lock contention report:
+contendedSum: 1000000 acquisitions, 4 contended (0.0%)
+  wait: total 14 ms, p50 < 8 ms, p99 < 8 ms
+  hold (15629 samples): p50 < 15 ns, p99 < 30 ns
+testContended: 4 acquisitions, 3 contended (75.0%)
+  wait: total 151 ms, p50 < 64 ms, p99 < 64 ms
+  hold (3 samples): p50 < 244 ns, p99 < 488 ns
+testNamedCritical: 107 acquisitions, 0 contended (0.0%)
+  hold (1 samples): p50 < 30 ns, p99 < 30 ns
+testRetired: 1 acquisitions, 0 contended (0.0%)
+testUncontended: 1000 acquisitions, 0 contended (0.0%)
+  hold (15 samples): p50 < 15 ns, p99 < 30 ns
+uncontendedBenchmark: 10000000 acquisitions, 0 contended (0.0%)
+  hold (156250 samples): p50 < 15 ns, p99 < 30 ns
+*/
+void benchmark()
+{
+    constexpr int N = 10'000'000;
+
+    omp_lock_t raw;
+    omp_init_lock(&raw);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i)
+    {
+        omp_set_lock(&raw);
+        omp_unset_lock(&raw);
+    }
+    chrono::duration<double, nano> rawTime = chrono::steady_clock::now() - start;
+    omp_destroy_lock(&raw);
+
+    InstrumentedLock lock("uncontendedBenchmark");
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i)
+    {
+        lock.lock();
+        lock.unlock();
+    }
+    chrono::duration<double, nano> instrumentedTime = chrono::steady_clock::now() - start;
+
+    cout << fixed << setprecision(1);
+    cout << "uncontended lock + unlock, " << N << " times:\n";
+    cout << "  omp_lock_t:       " << rawTime.count() / N << " ns\n";
+    cout << "  InstrumentedLock: " << instrumentedTime.count() / N << " ns (" << showpos
+         << (instrumentedTime.count() - rawTime.count()) / N << noshowpos << " ns)\n";
+
+    constexpr int ITERATIONS = 1'000'000;
+    long long sum = 0;
+    start = chrono::steady_clock::now();
+    #pragma omp parallel for
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        #pragma omp critical
+        sum += i;
+    }
+    chrono::duration<double, milli> criticalTime = chrono::steady_clock::now() - start;
+
+    long long instrumentedSum = 0;
+    start = chrono::steady_clock::now();
+    #pragma omp parallel for
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        INSTRUMENTED_CRITICAL(contendedSum)
+        {
+            instrumentedSum += i;
+        }
+    }
+    chrono::duration<double, milli> instrumentedCriticalTime = chrono::steady_clock::now() - start;
+    assert(sum == instrumentedSum);
+
+    cout << "contended sum, " << omp_get_max_threads() << " threads, " << ITERATIONS << " iterations:\n";
+    cout << "  omp critical:          " << criticalTime.count() << " ms\n";
+    cout << "  INSTRUMENTED_CRITICAL: " << instrumentedCriticalTime.count() << " ms\n";
+    cout << defaultfloat;
+}
+
+void test()
+{
+    testHistogram();
+    testUncontended();
+    testContended();
+    testNamedCritical();
+    testRetiredStats();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,498 @@
+/*
+Parallel k-means clustering (Lloyd's algorithm, and Elkan's accelerated version).
+https://en.wikipedia.org/wiki/K-means_clustering
+
+Each iteration has two steps with a barrier between them:
+1. assign: every point finds its nearest centroid (embarrassingly parallel)
+2. update: every centroid becomes the mean of its points. This is a reduction into
+   k * dims sums and k counts, not into one scalar as in Reduction.cpp. OpenMP 4.5
+   array sections do this: 'reduction(+ : sums[:k * dims])' gives every thread its
+   own accumulators, merged once at the end of the loop.
+
+Points are stored as blocked structure-of-arrays: for each block of 16 points,
+coordinate d of the 16 points is one contiguous 64-byte line. The nearest-centroid
+search then runs '#pragma omp simd' over the 16 points of a block.
+
+Elkan's algorithm keeps an upper bound on the distance to the assigned centroid and
+a lower bound to every other centroid, and uses the triangle inequality to skip most
+distance computations once the centroids stop moving much.
+https://cdn.aaai.org/ICML/2003/ICML03-022.pdf
+
+Usage: KMeans [points] [dims]...
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// points per block: one 64-byte cache line of floats per dimension
+constexpr int LANES = 16;
+
+struct Points
+{
+    size_t n = 0;
+    int dims = 0;
+    vector<float> data; // data[(b * dims + d) * LANES + lane] is coordinate d of point b * LANES + lane
+
+    Points(size_t count, int dimensions)
+        : n(count), dims(dimensions), data(blocks() * dimensions * LANES, 0.0f)
+    {
+    }
+
+    size_t blocks() const { return (n + LANES - 1) / LANES; }
+
+    float &at(size_t i, int d) { return data[((i / LANES) * dims + d) * LANES + i % LANES]; }
+    float at(size_t i, int d) const { return data[((i / LANES) * dims + d) * LANES + i % LANES]; }
+};
+
+struct KMeansResult
+{
+    vector<float> centroids; // centroids[c * dims + d]
+    vector<int> labels;      // nearest centroid of each point
+    int iterations = 0;
+    long long distances = 0; // point-centroid distances computed
+};
+
+inline uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+n points around k random centers in [0, 100)^dims, with normal noise of the given
+spread. Deterministic for a seed, whatever the thread count.
+*/
+Points gaussianBlobs(size_t n, int dims, int k, double spread, uint64_t seed)
+{
+    vector<float> centers(size_t(k) * dims);
+    for (size_t j = 0; j < centers.size(); ++j)
+        centers[j] = float((splitMix64(seed + j) >> 11) * 0x1.0p-53 * 100.0);
+
+    Points points(n, dims);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint64_t state = splitMix64(seed ^ (i * 0x100000001b3ULL));
+        const int center = int(state % k);
+        for (int d = 0; d < dims; ++d)
+        {
+            // Box-Muller
+            state = splitMix64(state);
+            const double u1 = ((state >> 11) + 0.5) * 0x1.0p-53;
+            state = splitMix64(state);
+            const double u2 = (state >> 11) * 0x1.0p-53;
+            const double z = sqrt(-2.0 * log(u1)) * cos(2.0 * numbers::pi * u2);
+            points.at(i, d) = float(centers[size_t(center) * dims + d] + spread * z);
+        }
+    }
+    return points;
+}
+
+// deterministic start: points spread evenly through the input
+vector<float> initialCentroids(const Points &points, int k)
+{
+    vector<float> centroids(size_t(k) * points.dims);
+    for (int c = 0; c < k; ++c)
+        for (int d = 0; d < points.dims; ++d)
+            centroids[size_t(c) * points.dims + d] = points.at(points.n * c / k, d);
+    return centroids;
+}
+
+// nearest centroid of the 16 points of block b, vectorized over the points
+void nearestInBlock(const Points &points, size_t b, const vector<float> &centroids, int k, int best[LANES])
+{
+    const int dims = points.dims;
+    const float *block = points.data.data() + b * dims * LANES;
+
+    float bestDistance[LANES];
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        bestDistance[lane] = numeric_limits<float>::infinity();
+        best[lane] = 0;
+    }
+
+    for (int c = 0; c < k; ++c)
+    {
+        const float *centroid = centroids.data() + size_t(c) * dims;
+        float distance[LANES] = {};
+        for (int d = 0; d < dims; ++d)
+        {
+            const float x = centroid[d];
+            const float *coordinate = block + d * LANES;
+
+            #pragma omp simd
+            for (int lane = 0; lane < LANES; ++lane)
+            {
+                const float diff = coordinate[lane] - x;
+                distance[lane] += diff * diff;
+            }
+        }
+
+        #pragma omp simd
+        for (int lane = 0; lane < LANES; ++lane)
+        {
+            if (distance[lane] < bestDistance[lane])
+            {
+                bestDistance[lane] = distance[lane];
+                best[lane] = c;
+            }
+        }
+    }
+}
+
+// Euclidean distance of one point to one centroid, summed in the same order as nearestInBlock
+float distance(const Points &points, size_t i, const vector<float> &centroids, int c)
+{
+    const float *coordinate = points.data.data() + (i / LANES) * points.dims * LANES + i % LANES;
+    const float *centroid = centroids.data() + size_t(c) * points.dims;
+    float sum = 0.0f;
+    for (int d = 0; d < points.dims; ++d)
+    {
+        const float diff = coordinate[d * LANES] - centroid[d];
+        sum += diff * diff;
+    }
+    return sqrt(sum);
+}
+
+// means from the reduced sums. a cluster that lost all its points keeps its centroid.
+void updateCentroids(const vector<double> &sums, const vector<long long> &counts, int dims, vector<float> &centroids)
+{
+    for (size_t c = 0; c < counts.size(); ++c)
+    {
+        if (counts[c] == 0)
+            continue;
+        for (int d = 0; d < dims; ++d)
+            centroids[c * dims + d] = float(sums[c * dims + d] / counts[c]);
+    }
+}
+
+KMeansResult lloyd(const Points &points, int k, int maxIterations)
+{
+    const int dims = points.dims;
+    const long long blocks = static_cast<long long>(points.blocks());
+
+    KMeansResult result;
+    result.centroids = initialCentroids(points, k);
+    result.labels.assign(points.n, -1);
+
+    vector<double> sums(size_t(k) * dims);
+    vector<long long> counts(k);
+    while (result.iterations < maxIterations)
+    {
+        fill(sums.begin(), sums.end(), 0.0);
+        fill(counts.begin(), counts.end(), 0);
+        double *s = sums.data();
+        long long *count = counts.data();
+        long long changed = 0;
+        const size_t sumCount = sums.size();
+
+        // assign and accumulate in one pass. each thread has private copies of s and count.
+        #pragma omp parallel for schedule(static) reduction(+ : s[:sumCount], count[:k], changed)
+        for (long long b = 0; b < blocks; ++b)
+        {
+            int best[LANES];
+            nearestInBlock(points, b, result.centroids, k, best);
+
+            const float *block = points.data.data() + b * dims * LANES;
+            const int valid = static_cast<int>(min<size_t>(LANES, points.n - b * LANES));
+            for (int lane = 0; lane < valid; ++lane)
+            {
+                const int c = best[lane];
+                int &label = result.labels[b * LANES + lane];
+                changed += label != c;
+                label = c;
+
+                ++count[c];
+                for (int d = 0; d < dims; ++d)
+                    s[size_t(c) * dims + d] += block[d * LANES + lane];
+            }
+        }
+
+        // implicit barrier: all assignments are done before the update
+        updateCentroids(sums, counts, dims, result.centroids);
+        result.distances += static_cast<long long>(points.n) * k;
+        ++result.iterations;
+        if (changed == 0)
+            break;
+    }
+    return result;
+}
+
+KMeansResult elkan(const Points &points, int k, int maxIterations)
+{
+    const int dims = points.dims;
+    const long long n = static_cast<long long>(points.n);
+
+    KMeansResult result;
+    result.centroids = initialCentroids(points, k);
+    result.labels.assign(points.n, -1);
+
+    vector<float> upper(points.n);                // >= distance to the assigned centroid
+    vector<float> lower(points.n * k);            // <= distance to each centroid
+    vector<float> between(size_t(k) * k), half(k); // centroid distances, half the nearest other one
+    vector<double> sums(size_t(k) * dims);
+    vector<long long> counts(k);
+    vector<float> previous;
+
+    while (result.iterations < maxIterations)
+    {
+        for (int a = 0; a < k; ++a)
+        {
+            half[a] = numeric_limits<float>::infinity();
+            for (int c = 0; c < k; ++c)
+            {
+                float sum = 0.0f;
+                for (int d = 0; d < dims; ++d)
+                {
+                    const float diff = result.centroids[size_t(a) * dims + d] - result.centroids[size_t(c) * dims + d];
+                    sum += diff * diff;
+                }
+                between[size_t(a) * k + c] = sqrt(sum);
+                if (c != a)
+                    half[a] = min(half[a], sqrt(sum) / 2);
+            }
+        }
+
+        fill(sums.begin(), sums.end(), 0.0);
+        fill(counts.begin(), counts.end(), 0);
+        double *s = sums.data();
+        long long *count = counts.data();
+        long long changed = 0, distances = 0;
+        const size_t sumCount = sums.size();
+        const bool first = result.iterations == 0;
+
+        // the work per point varies with how much the bounds prune
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : s[:sumCount], count[:k], changed, distances)
+        for (long long i = 0; i < n; ++i)
+        {
+            float *l = lower.data() + size_t(i) * k;
+            int label = result.labels[i];
+
+            if (first)
+            {
+                // every distance is computed once to set up the bounds
+                label = 0;
+                for (int c = 0; c < k; ++c)
+                {
+                    l[c] = distance(points, i, result.centroids, c);
+                    if (l[c] < l[label])
+                        label = c;
+                }
+                upper[i] = l[label];
+                distances += k;
+            }
+            else if (upper[i] > half[label])
+            {
+                bool stale = true; // upper[i] is a bound, not the exact distance
+                for (int c = 0; c < k; ++c)
+                {
+                    if (c == label || upper[i] <= l[c] || upper[i] <= between[size_t(label) * k + c] / 2)
+                        continue;
+
+                    if (stale)
+                    {
+                        upper[i] = l[label] = distance(points, i, result.centroids, label);
+                        ++distances;
+                        stale = false;
+                        if (upper[i] <= l[c] || upper[i] <= between[size_t(label) * k + c] / 2)
+                            continue;
+                    }
+
+                    l[c] = distance(points, i, result.centroids, c);
+                    ++distances;
+                    if (l[c] < upper[i])
+                    {
+                        label = c;
+                        upper[i] = l[c];
+                    }
+                }
+            }
+
+            changed += result.labels[i] != label;
+            result.labels[i] = label;
+            ++count[label];
+            for (int d = 0; d < dims; ++d)
+                s[size_t(label) * dims + d] += points.at(i, d);
+        }
+
+        previous = result.centroids;
+        updateCentroids(sums, counts, dims, result.centroids);
+        result.distances += distances;
+        ++result.iterations;
+        if (changed == 0)
+            break;
+
+        // move the bounds by how far each centroid moved
+        vector<float> shift(k);
+        for (int c = 0; c < k; ++c)
+        {
+            float sum = 0.0f;
+            for (int d = 0; d < dims; ++d)
+            {
+                const float diff = result.centroids[size_t(c) * dims + d] - previous[size_t(c) * dims + d];
+                sum += diff * diff;
+            }
+            shift[c] = sqrt(sum);
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < n; ++i)
+        {
+            float *l = lower.data() + size_t(i) * k;
+            for (int c = 0; c < k; ++c)
+                l[c] = max(0.0f, l[c] - shift[c]);
+            upper[i] += shift[result.labels[i]];
+        }
+    }
+    return result;
+}
+
+// fraction of points with different labels
+double mislabeledFraction(const vector<int> &labels, const vector<int> &reference)
+{
+    size_t different = 0;
+    for (size_t i = 0; i < labels.size(); ++i)
+        different += labels[i] != reference[i];
+    return double(different) / labels.size();
+}
+
+void testPoints()
+{
+    Points points(20, 3);
+    assert(points.blocks() == 2 && points.data.size() == 2 * 3 * LANES);
+    points.at(17, 2) = 5.0f;
+    assert(points.data[(1 * 3 + 2) * LANES + 1] == 5.0f);
+}
+
+void testNearestInBlock()
+{
+    const Points points = gaussianBlobs(1000, 5, 7, 10.0, 3);
+    const vector<float> centroids = initialCentroids(points, 7);
+
+    for (size_t b = 0; b < points.blocks(); ++b)
+    {
+        int best[LANES];
+        nearestInBlock(points, b, centroids, 7, best);
+        for (int lane = 0; lane < LANES && b * LANES + lane < points.n; ++lane)
+        {
+            const size_t i = b * LANES + lane;
+            for (int c = 0; c < 7; ++c)
+                assert(distance(points, i, centroids, best[lane]) <= distance(points, i, centroids, c));
+        }
+    }
+}
+
+void testLloydAndElkan()
+{
+    // well separated blobs: both algorithms find the same clustering
+    const Points points = gaussianBlobs(20'000, 4, 5, 0.5, 11);
+    const KMeansResult a = lloyd(points, 5, 100);
+    const KMeansResult b = elkan(points, 5, 100);
+    assert(a.labels == b.labels);
+    assert(a.iterations == b.iterations && a.iterations < 100);
+    for (size_t j = 0; j < a.centroids.size(); ++j)
+        assert(fabs(a.centroids[j] - b.centroids[j]) < 1e-3f);
+
+    // overlapping blobs, many iterations: Elkan computes far fewer distances.
+    // rounding can break a few near-ties differently.
+    const Points noisy = gaussianBlobs(20'000, 8, 16, 15.0, 5);
+    const KMeansResult c = lloyd(noisy, 16, 30);
+    const KMeansResult d = elkan(noisy, 16, 30);
+    assert(mislabeledFraction(c.labels, d.labels) < 1e-3);
+    assert(d.distances < c.distances / 2);
+}
+
+void testThreadCounts()
+{
+    const int saved = omp_get_max_threads();
+    const Points points = gaussianBlobs(5'000, 3, 4, 1.0, 2);
+
+    omp_set_num_threads(1);
+    const KMeansResult reference = lloyd(points, 4, 50);
+    for (int threads : {2, 3, 5})
+    {
+        omp_set_num_threads(threads);
+        assert(lloyd(points, 4, 50).labels == reference.labels);
+        assert(elkan(points, 4, 50).labels == reference.labels);
+    }
+    omp_set_num_threads(saved);
+}
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output (1 core):
+1000000 points, k = 16, 4 threads
+dims  method  iterations  ms/iteration  Mpoints/s  distances/point/iteration
+2	lloyd	20	    51.8858	  19.2731	     16
+2	elkan	20	    86.1968	  11.6014	     1.28286
+16	lloyd	20	    114.538	  8.73071	     16
+16	elkan	20	    110.486	  9.0509	     1.59042
+128	lloyd	20	    542.527	  1.84322	     16
+128	elkan	20	    321.042	  3.11486	     1.52463
+*/
+void benchmark(size_t n, const vector<int> &dimsList)
+{
+    const int k = 16, maxIterations = 20;
+    cout << n << " points, k = " << k << ", " << omp_get_max_threads() << " threads\n";
+    cout << "dims  method  iterations  ms/iteration  Mpoints/s  distances/point/iteration\n";
+
+    for (int dims : dimsList)
+    {
+        const Points points = gaussianBlobs(n, dims, k, 20.0, 1);
+        for (bool useElkan : {false, true})
+        {
+            KMeansResult r;
+            const double seconds = secondsFor([&] { r = useElkan ? elkan(points, k, maxIterations) : lloyd(points, k, maxIterations); });
+            cout << dims << "\t" << (useElkan ? "elkan" : "lloyd") << "\t" << r.iterations << "\t    "
+                 << seconds * 1e3 / r.iterations << "\t  " << n * r.iterations / seconds / 1e6 << "\t     "
+                 << double(r.distances) / n / r.iterations << '\n';
+        }
+    }
+}
+
+void test()
+{
+    testPoints();
+    testNearestInBlock();
+    testLloydAndElkan();
+    testThreadCounts();
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t n = argc > 1 ? stoull(argv[1]) : 1'000'000;
+    vector<int> dimsList;
+    for (int i = 2; i < argc; ++i)
+        dimsList.push_back(stoi(argv[i]));
+    if (dimsList.empty())
+        dimsList = {2, 16, 128};
+
+    test();
+    benchmark(n, dimsList);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
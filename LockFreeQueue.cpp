@@ -0,0 +1,427 @@
+/*
+Lock-free data structures built only from OpenMP atomics.
+
+atomic capture: reads the old value and updates the variable as one atomic operation
+(a fetch-and-add):
+#pragma omp atomic capture
+{ old = x; x += n; }
+
+atomic compare (OpenMP 5.1): a compare-and-swap. Capturing the old value tells
+the caller whether the swap happened:
+#pragma omp atomic compare capture
+{ old = x; if (x == expected) { x = desired; } }
+
+Memory-order clauses control what else becomes visible with the atomic:
+- relaxed: only the variable itself is atomic (the default)
+- release: earlier writes are visible to a thread that acquires this value
+- acquire: later reads see everything written before the matching release
+- acq_rel: both, for read-modify-write operations
+- seq_cst: acq_rel plus a single total order over all seq_cst operations
+
+This file contains:
+1. MpmcQueue: Dmitry Vyukov's bounded multi-producer multi-consumer queue
+   https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+2. ChunkDispenser: hands out [begin, end) ranges of a loop with one fetch-and-add
+3. LockedQueue: std::queue protected by omp_lock_t, as the baseline
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// compare-and-swap on 'x'. returns true if x was 'expected' and is now 'desired'.
+inline bool compareAndSwap(size_t &x, size_t expected, size_t desired)
+{
+    size_t old;
+    #pragma omp atomic compare capture seq_cst
+    {
+        old = x;
+        if (x == expected) { x = desired; }
+    }
+    return old == expected;
+}
+
+/*
+Each cell holds a sequence number that says whose turn it is:
+- sequence == pos:     empty, the producer claiming position 'pos' may write it
+- sequence == pos + 1: full, the consumer claiming position 'pos' may read it
+After reading, the consumer sets sequence = pos + capacity, which is the next
+producer position that maps to the same cell.
+Producers and consumers claim positions with a CAS on their own counter, so they
+only contend with each other through the cell they share.
+*/
+template <typename T>
+class MpmcQueue
+{
+public:
+    // capacity must be a power of two
+    explicit MpmcQueue(size_t capacity)
+        : cells_(capacity), mask_(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; ++i)
+            cells_[i].sequence = i;
+    }
+
+    // returns false if the queue is full
+    bool tryPush(const T &value)
+    {
+        size_t pos;
+        #pragma omp atomic read relaxed
+        pos = enqueuePos_;
+
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            size_t seq;
+            #pragma omp atomic read acquire
+            seq = cell.sequence;
+
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (compareAndSwap(enqueuePos_, pos, pos + 1))
+                {
+                    cell.data = value;
+                    // publish the data: the consumer's acquire read of the sequence sees it
+                    #pragma omp atomic write release
+                    cell.sequence = pos + 1;
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // the cell still holds the value from one lap ago
+            }
+
+            // another producer took this position; retry from the current one
+            #pragma omp atomic read relaxed
+            pos = enqueuePos_;
+        }
+    }
+
+    // returns false if the queue is empty
+    bool tryPop(T &value)
+    {
+        size_t pos;
+        #pragma omp atomic read relaxed
+        pos = dequeuePos_;
+
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            size_t seq;
+            #pragma omp atomic read acquire
+            seq = cell.sequence;
+
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (compareAndSwap(dequeuePos_, pos, pos + 1))
+                {
+                    value = cell.data;
+                    // hand the cell to the producer one lap ahead
+                    #pragma omp atomic write release
+                    cell.sequence = pos + mask_ + 1;
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // nothing has been written to this cell yet
+            }
+
+            #pragma omp atomic read relaxed
+            pos = dequeuePos_;
+        }
+    }
+
+private:
+    struct alignas(64) Cell
+    {
+        size_t sequence{};
+        T data{};
+    };
+
+    vector<Cell> cells_;
+    const size_t mask_;
+
+    // separate cache lines so producers and consumers don't invalidate each other
+    alignas(64) size_t enqueuePos_ = 0;
+    alignas(64) size_t dequeuePos_ = 0;
+};
+
+// baseline: every push and pop takes the same lock
+template <typename T>
+class LockedQueue
+{
+public:
+    explicit LockedQueue(size_t capacity)
+        : capacity_(capacity)
+    {
+        omp_init_lock(&lock_);
+    }
+
+    ~LockedQueue() { omp_destroy_lock(&lock_); }
+
+    LockedQueue(const LockedQueue &) = delete;
+    LockedQueue &operator=(const LockedQueue &) = delete;
+
+    bool tryPush(const T &value)
+    {
+        omp_set_lock(&lock_);
+        bool pushed = queue_.size() < capacity_;
+        if (pushed)
+            queue_.push(value);
+        omp_unset_lock(&lock_);
+        return pushed;
+    }
+
+    bool tryPop(T &value)
+    {
+        omp_set_lock(&lock_);
+        bool popped = !queue_.empty();
+        if (popped)
+        {
+            value = queue_.front();
+            queue_.pop();
+        }
+        omp_unset_lock(&lock_);
+        return popped;
+    }
+
+private:
+    omp_lock_t lock_;
+    queue<T> queue_;
+    const size_t capacity_;
+};
+
+/*
+Work dispenser for loops with uneven iterations: each call claims the next
+'chunk' iterations with one fetch-and-add. This is what schedule(dynamic, chunk)
+does internally, but usable from any parallel code, such as a pool of tasks.
+*/
+class ChunkDispenser
+{
+public:
+    ChunkDispenser(long long total, long long chunk)
+        : total_(total), chunk_(chunk)
+    {
+    }
+
+    // claims [begin, end). returns false when all iterations have been handed out.
+    bool next(long long &begin, long long &end)
+    {
+        long long start;
+        #pragma omp atomic capture relaxed
+        {
+            start = next_;
+            next_ += chunk_;
+        }
+
+        if (start >= total_)
+            return false;
+
+        begin = start;
+        end = min(start + chunk_, total_);
+        return true;
+    }
+
+private:
+    alignas(64) long long next_ = 0;
+    const long long total_;
+    const long long chunk_;
+};
+
+/*
+Runs 'producers' threads that each push 'perProducer' values and 'consumers' threads
+that pop until everything has been consumed. Returns the sum of all popped values.
+Threads yield when the queue is full or empty so an oversubscribed machine still
+makes progress.
+*/
+template <typename Queue>
+long long runProducersConsumers(Queue &q, int producers, int consumers, long long perProducer)
+{
+    const long long total = producers * perProducer;
+    long long consumed = 0;
+    long long sum = 0;
+
+    #pragma omp parallel num_threads(producers + consumers) reduction(+ : sum)
+    {
+        // roles come from the actual team size in case fewer threads were granted
+        const int t = omp_get_thread_num();
+        const int team = omp_get_num_threads();
+        const int teamProducers = max(1, team * producers / (producers + consumers));
+
+        if (team == 1)
+        {
+            // a lone thread alternates so it never waits on itself
+            long long value = 0;
+            for (long long i = 0; i < total; ++i)
+            {
+                q.tryPush(i + 1);
+                q.tryPop(value);
+                sum += value;
+            }
+        }
+        else if (t < teamProducers)
+        {
+            for (long long i = t; i < total; i += teamProducers)
+            {
+                while (!q.tryPush(i + 1))
+                    this_thread::yield();
+            }
+        }
+        else
+        {
+            for (;;)
+            {
+                long long done;
+                #pragma omp atomic read acquire
+                done = consumed;
+                if (done >= total)
+                    break;
+
+                long long value;
+                if (q.tryPop(value))
+                {
+                    sum += value;
+                    #pragma omp atomic update relaxed
+                    ++consumed;
+                }
+                else
+                {
+                    this_thread::yield();
+                }
+            }
+        }
+    }
+
+    return sum;
+}
+
+void testCompareAndSwap()
+{
+    size_t x = 5;
+    assert(!compareAndSwap(x, 4, 10));
+    assert(x == 5);
+    assert(compareAndSwap(x, 5, 10));
+    assert(x == 10);
+}
+
+void testQueueSingleThread()
+{
+    MpmcQueue<int> q(4);
+    int value = 0;
+    assert(!q.tryPop(value));
+
+    // fill, then check FIFO order and wrap-around over several laps
+    for (int lap = 0; lap < 3; ++lap)
+    {
+        for (int i = 0; i < 4; ++i)
+            assert(q.tryPush(lap * 10 + i));
+        assert(!q.tryPush(99)); // full
+
+        for (int i = 0; i < 4; ++i)
+        {
+            assert(q.tryPop(value));
+            assert(value == lap * 10 + i);
+        }
+        assert(!q.tryPop(value));
+    }
+}
+
+void testQueueConcurrent()
+{
+    const long long perProducer = 20'000;
+    const int producers = 3, consumers = 3;
+    const long long n = producers * perProducer;
+    const long long expected = n * (n + 1) / 2; // values 1..n are pushed exactly once
+
+    MpmcQueue<long long> lockFree(64);
+    assert(runProducersConsumers(lockFree, producers, consumers, perProducer) == expected);
+
+    LockedQueue<long long> locked(64);
+    assert(runProducersConsumers(locked, producers, consumers, perProducer) == expected);
+}
+
+void testChunkDispenser()
+{
+    const long long n = 100'003;
+    vector<int> visits(n, 0);
+    ChunkDispenser dispenser(n, 64);
+
+    #pragma omp parallel
+    {
+        long long begin, end;
+        while (dispenser.next(begin, end))
+        {
+            for (long long i = begin; i < end; ++i)
+                ++visits[i]; // ranges never overlap, so no synchronization is needed
+        }
+    }
+
+    // every iteration was handed out exactly once
+    assert(all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }));
+}
+
+template <typename Queue>
+double millionOpsPerSecond(int producers, int consumers, long long perProducer)
+{
+    Queue q(1024);
+    auto start = chrono::steady_clock::now();
+    runProducersConsumers(q, producers, consumers, perProducer);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // one push and one pop per item
+    return 2.0 * producers * perProducer / elapsed.count() / 1e6;
+}
+
+/* Sample output:
+threads  (producers/consumers)  lock-free Mops/s  omp_lock Mops/s
+2        (1/1)                  59.8566           42.1249
+4        (2/2)                  59.5182           41.8106
+*/
+void benchmark()
+{
+    const long long perProducer = 1'000'000;
+    const int maxThreads = max(2, omp_get_max_threads());
+
+    cout << "threads  (producers/consumers)  lock-free Mops/s  omp_lock Mops/s\n";
+    for (int threads = 2; threads <= maxThreads; threads *= 2)
+    {
+        const int producers = threads / 2, consumers = threads - threads / 2;
+        cout << threads << "\t (" << producers << '/' << consumers << ")\t\t\t"
+             << millionOpsPerSecond<MpmcQueue<long long>>(producers, consumers, perProducer) << "\t  "
+             << millionOpsPerSecond<LockedQueue<long long>>(producers, consumers, perProducer) << '\n';
+    }
+}
+
+void test()
+{
+    testCompareAndSwap();
+    testQueueSingleThread();
+    testQueueConcurrent();
+    testChunkDispenser();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
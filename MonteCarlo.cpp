@@ -0,0 +1,436 @@
+/*
+Parallel Monte Carlo with counter-based random number generators.
+https://www.thesalmons.org/john/random123/papers/random123sc11.pdf (Salmon et al.)
+
+A shared std::mt19937 must sit behind a critical section, so every thread waits
+for every random number. One engine per thread scales, but the results then
+depend on how many threads ran and which iterations each one got.
+
+A counter-based generator is a pure function: random = f(key, counter). Sample i
+uses counter i, so any thread can compute any sample's random numbers with no
+shared state, and the values are the same for any thread count or schedule.
+- Philox4x32-10: 10 rounds of 32x32->64 bit multiplies, 4 x 32-bit outputs
+- Threefry2x64-20: 20 rounds of add/rotate/xor, 2 x 64-bit outputs
+Both are selectable with Generator; Philox is the default.
+
+Sums of doubles are also order-dependent, so samples are grouped into blocks of a
+fixed size. Each block is summed in sample order and the block sums are added in
+block order. Each block's random numbers are generated in one SIMD batch.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <numbers>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// samples per block. fixed, so results do not depend on the team size.
+constexpr uint64_t BLOCK = 4096;
+
+struct Philox4x32
+{
+    using Counter = array<uint32_t, 4>;
+    using Key = array<uint32_t, 2>;
+
+    static Counter generate(Counter c, Key k)
+    {
+        for (int round = 0; round < 10; ++round)
+        {
+            if (round > 0)
+            {
+                k[0] += 0x9E3779B9; // Weyl sequence key schedule
+                k[1] += 0xBB67AE85;
+            }
+
+            const uint64_t p0 = uint64_t(0xD2511F53) * c[0];
+            const uint64_t p1 = uint64_t(0xCD9E8D57) * c[2];
+            c = {uint32_t(p1 >> 32) ^ c[1] ^ k[0], uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k[1], uint32_t(p0)};
+        }
+        return c;
+    }
+};
+
+struct Threefry2x64
+{
+    using Counter = array<uint64_t, 2>;
+    using Key = array<uint64_t, 2>;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static Counter generate(Counter c, Key k)
+    {
+        static constexpr int ROTATIONS[8] = {16, 42, 12, 31, 16, 32, 24, 21};
+        const uint64_t ks[3] = {k[0], k[1], 0x1BD11BDAA9FC1A22ULL ^ k[0] ^ k[1]};
+
+        uint64_t x0 = c[0] + ks[0];
+        uint64_t x1 = c[1] + ks[1];
+        for (int round = 0; round < 20; ++round)
+        {
+            x0 += x1;
+            x1 = rotl(x1, ROTATIONS[round % 8]);
+            x1 ^= x0;
+
+            // inject the key every 4 rounds
+            if (round % 4 == 3)
+            {
+                const int s = (round + 1) / 4;
+                x0 += ks[s % 3];
+                x1 += ks[(s + 1) % 3] + s;
+            }
+        }
+        return {x0, x1};
+    }
+};
+
+// uniform double in (0, 1) from 53 random bits. never 0, so log() is safe.
+inline double toUniform(uint32_t hi, uint32_t lo)
+{
+    const uint64_t bits = ((uint64_t(hi) << 32) | lo) >> 11;
+    return (bits + 0.5) * 0x1.0p-53;
+}
+
+/*
+Philox for 'count' consecutive counters starting at 'first', in structure-of-arrays
+form (out[w][i] is word w of sample i). Independent lanes let '#pragma omp simd'
+run several generators per instruction.
+*/
+void philoxBatch(uint64_t first, size_t count, Philox4x32::Key key, uint32_t *out[4])
+{
+    uint32_t *o0 = out[0], *o1 = out[1], *o2 = out[2], *o3 = out[3];
+
+    #pragma omp simd
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t n = first + i;
+        uint32_t c0 = uint32_t(n), c1 = uint32_t(n >> 32), c2 = 0, c3 = 0;
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for (int round = 0; round < 10; ++round)
+        {
+            const uint64_t p0 = uint64_t(0xD2511F53) * c0;
+            const uint64_t p1 = uint64_t(0xCD9E8D57) * c2;
+            const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+            const uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+            c1 = uint32_t(p1);
+            c3 = uint32_t(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+
+        o0[i] = c0;
+        o1[i] = c1;
+        o2[i] = c2;
+        o3[i] = c3;
+    }
+}
+
+Philox4x32::Key keyFromSeed(uint64_t seed)
+{
+    return {uint32_t(seed), uint32_t(seed >> 32)};
+}
+
+// Threefry for the same counters, split into the same 4 x 32-bit words per sample
+void threefryBatch(uint64_t first, size_t count, Threefry2x64::Key key, uint32_t *out[4])
+{
+    uint32_t *o0 = out[0], *o1 = out[1], *o2 = out[2], *o3 = out[3];
+
+    #pragma omp simd
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Threefry2x64::Counter x = Threefry2x64::generate({first + i, 0}, key);
+        o0[i] = uint32_t(x[0] >> 32);
+        o1[i] = uint32_t(x[0]);
+        o2[i] = uint32_t(x[1] >> 32);
+        o3[i] = uint32_t(x[1]);
+    }
+}
+
+enum class Generator
+{
+    Philox,
+    Threefry,
+};
+
+// the 4 words of samples [first, first + count) from the chosen generator
+void generateBatch(Generator generator, uint64_t first, size_t count, uint64_t seed, uint32_t *out[4])
+{
+    if (generator == Generator::Philox)
+        philoxBatch(first, count, keyFromSeed(seed), out);
+    else
+        threefryBatch(first, count, {seed, 0}, out);
+}
+
+/*
+Sum of sample(u[0..3]) over samples [0, samples), where u are the 4 words the
+generator gives that sample. Blocks are distributed with schedule(dynamic) on purpose: the result is
+bit-identical for any thread count and any schedule.
+*/
+template <typename Sample>
+double monteCarloSum(uint64_t samples, uint64_t seed, Sample sample, int threads = omp_get_max_threads(),
+                     Generator generator = Generator::Philox)
+{
+    const long long blocks = static_cast<long long>((samples + BLOCK - 1) / BLOCK);
+    vector<double> blockSums(blocks);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        vector<uint32_t> buffer(4 * BLOCK);
+        uint32_t *words[4] = {buffer.data(), buffer.data() + BLOCK, buffer.data() + 2 * BLOCK, buffer.data() + 3 * BLOCK};
+
+        #pragma omp for schedule(dynamic)
+        for (long long b = 0; b < blocks; ++b)
+        {
+            const uint64_t first = uint64_t(b) * BLOCK;
+            const size_t count = static_cast<size_t>(min(BLOCK, samples - first));
+            generateBatch(generator, first, count, seed, words);
+
+            double sum = 0.0;
+            for (size_t i = 0; i < count; ++i)
+                sum += sample(words[0][i], words[1][i], words[2][i], words[3][i]);
+            blockSums[b] = sum;
+        }
+    }
+
+    double total = 0.0;
+    for (double s : blockSums)
+        total += s;
+    return total;
+}
+
+// fraction of points in the unit square that fall inside the quarter circle is pi / 4
+double estimatePi(uint64_t samples, uint64_t seed, int threads = omp_get_max_threads(),
+                  Generator generator = Generator::Philox)
+{
+    const double inside = monteCarloSum(
+        samples, seed,
+        [](uint32_t w0, uint32_t w1, uint32_t w2, uint32_t w3) {
+            const double x = toUniform(w0, w1), y = toUniform(w2, w3);
+            return x * x + y * y <= 1.0 ? 1.0 : 0.0;
+        },
+        threads, generator);
+    return 4.0 * inside / samples;
+}
+
+struct EuropeanCall
+{
+    double spot, strike, rate, volatility, years;
+
+    // closed-form Black-Scholes price, to check the simulation against
+    double blackScholes() const
+    {
+        const double d1 = (log(spot / strike) + (rate + volatility * volatility / 2) * years) / (volatility * sqrt(years));
+        const double d2 = d1 - volatility * sqrt(years);
+        auto cdf = [](double x) { return 0.5 * erfc(-x / sqrt(2.0)); };
+        return spot * cdf(d1) - strike * exp(-rate * years) * cdf(d2);
+    }
+};
+
+// discounted mean payoff over simulated prices at expiry. Box-Muller turns 2 uniforms into a normal.
+double priceOption(const EuropeanCall &option, uint64_t samples, uint64_t seed, int threads = omp_get_max_threads(),
+                   Generator generator = Generator::Philox)
+{
+    const double drift = (option.rate - option.volatility * option.volatility / 2) * option.years;
+    const double diffusion = option.volatility * sqrt(option.years);
+
+    const double total = monteCarloSum(
+        samples, seed,
+        [&](uint32_t w0, uint32_t w1, uint32_t w2, uint32_t w3) {
+            const double z = sqrt(-2.0 * log(toUniform(w0, w1))) * cos(2.0 * numbers::pi * toUniform(w2, w3));
+            const double price = option.spot * exp(drift + diffusion * z);
+            return max(price - option.strike, 0.0);
+        },
+        threads, generator);
+    return exp(-option.rate * option.years) * total / samples;
+}
+
+// baseline: one shared engine behind a critical section
+double estimatePiSharedEngine(uint64_t samples, uint64_t seed)
+{
+    mt19937_64 engine(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    long long inside = 0;
+
+    #pragma omp parallel for reduction(+ : inside)
+    for (long long i = 0; i < static_cast<long long>(samples); ++i)
+    {
+        double x, y;
+        #pragma omp critical(sharedEngine)
+        {
+            x = uniform(engine);
+            y = uniform(engine);
+        }
+        inside += x * x + y * y <= 1.0;
+    }
+    return 4.0 * double(inside) / samples;
+}
+
+// baseline: one engine per thread. scales, but the result depends on the thread count.
+double estimatePiPerThreadEngine(uint64_t samples, uint64_t seed)
+{
+    long long inside = 0;
+
+    #pragma omp parallel reduction(+ : inside)
+    {
+        mt19937_64 engine(seed + omp_get_thread_num());
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        #pragma omp for
+        for (long long i = 0; i < static_cast<long long>(samples); ++i)
+        {
+            const double x = uniform(engine), y = uniform(engine);
+            inside += x * x + y * y <= 1.0;
+        }
+    }
+    return 4.0 * double(inside) / samples;
+}
+
+bool sameBits(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// known-answer tests from the Random123 distribution (kat_vectors)
+void testKnownAnswers()
+{
+    assert((Philox4x32::generate({0, 0, 0, 0}, {0, 0}) == Philox4x32::Counter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    assert((Philox4x32::generate({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}) ==
+            Philox4x32::Counter{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    assert((Philox4x32::generate({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}) ==
+            Philox4x32::Counter{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+    assert((Threefry2x64::generate({0, 0}, {0, 0}) == Threefry2x64::Counter{0xc2b6e3a8c2c69865ULL, 0x6f81ed42f350084dULL}));
+}
+
+void testBatchMatchesScalar()
+{
+    const Philox4x32::Key key = keyFromSeed(0x123456789abcdefULL);
+    const uint64_t first = (uint64_t(1) << 32) - 5; // crosses into the high counter word
+    const size_t count = 37;
+
+    vector<uint32_t> buffer(4 * count);
+    uint32_t *words[4] = {buffer.data(), buffer.data() + count, buffer.data() + 2 * count, buffer.data() + 3 * count};
+    philoxBatch(first, count, key, words);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t n = first + i;
+        Philox4x32::Counter expected = Philox4x32::generate({uint32_t(n), uint32_t(n >> 32), 0, 0}, key);
+        for (int w = 0; w < 4; ++w)
+            assert(words[w][i] == expected[w]);
+    }
+
+    const Threefry2x64::Key threefryKey = {0x123456789abcdefULL, 0};
+    threefryBatch(first, count, threefryKey, words);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Threefry2x64::Counter expected = Threefry2x64::generate({first + i, 0}, threefryKey);
+        assert(words[0][i] == uint32_t(expected[0] >> 32) && words[1][i] == uint32_t(expected[0]));
+        assert(words[2][i] == uint32_t(expected[1] >> 32) && words[3][i] == uint32_t(expected[1]));
+    }
+}
+
+void testReproducible()
+{
+    const uint64_t samples = 1'000'003; // not a multiple of the block size
+    const double pi = estimatePi(samples, 42, 1);
+    const EuropeanCall option{100.0, 100.0, 0.05, 0.2, 1.0};
+    const double price = priceOption(option, samples, 42, 1);
+    const double threefryPi = estimatePi(samples, 42, 1, Generator::Threefry);
+
+    for (int threads = 2; threads <= max(4, omp_get_max_threads()); ++threads)
+    {
+        assert(sameBits(estimatePi(samples, 42, threads), pi));
+        assert(sameBits(priceOption(option, samples, 42, threads), price));
+        assert(sameBits(estimatePi(samples, 42, threads, Generator::Threefry), threefryPi));
+    }
+
+    // the generators are different streams
+    assert(!sameBits(threefryPi, pi));
+
+    // a different seed gives a different stream
+    assert(!sameBits(estimatePi(samples, 43, 1), pi));
+}
+
+void testAccuracy()
+{
+    assert(fabs(estimatePi(4'000'000, 7) - numbers::pi) < 0.005);
+    assert(fabs(estimatePi(4'000'000, 7, omp_get_max_threads(), Generator::Threefry) - numbers::pi) < 0.005);
+
+    // standard error is about 0.007 at 4M samples
+    const EuropeanCall option{100.0, 100.0, 0.05, 0.2, 1.0};
+    assert(fabs(option.blackScholes() - 10.4506) < 1e-4);
+    assert(fabs(priceOption(option, 4'000'000, 7) - option.blackScholes()) < 0.05);
+    assert(fabs(priceOption(option, 4'000'000, 7, omp_get_max_threads(), Generator::Threefry) - option.blackScholes()) < 0.05);
+}
+
+template <typename Fn>
+double millionSamplesPerSecond(uint64_t samples, Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return samples / elapsed.count() / 1e6;
+}
+
+/* Sample output (4 threads sharing 1 core, so no contention on the critical section):
+4 threads
+pi, shared mt19937 + critical:  28.4114 Msamples/s
+pi, mt19937 per thread:         36.526 Msamples/s (not reproducible)
+pi, Philox batched:             93.3184 Msamples/s
+pi, Threefry batched:           42.1915 Msamples/s
+option, Philox batched:         24.9188 Msamples/s
+option, Threefry batched:       18.2225 Msamples/s
+
+Threefry's 64-bit adds and rotates don't vectorize without AVX-512, so Philox's 32-bit
+multiplies win here.
+*/
+void benchmark()
+{
+    const uint64_t samples = 20'000'000;
+    const EuropeanCall option{100.0, 100.0, 0.05, 0.2, 1.0};
+
+    cout << omp_get_max_threads() << " threads\n";
+    cout << "pi, shared mt19937 + critical:  "
+         << millionSamplesPerSecond(samples / 4, [&] { estimatePiSharedEngine(samples / 4, 1); }) << " Msamples/s\n";
+    cout << "pi, mt19937 per thread:         "
+         << millionSamplesPerSecond(samples, [&] { estimatePiPerThreadEngine(samples, 1); }) << " Msamples/s (not reproducible)\n";
+    cout << "pi, Philox batched:             "
+         << millionSamplesPerSecond(samples, [&] { estimatePi(samples, 1); }) << " Msamples/s\n";
+    cout << "pi, Threefry batched:           "
+         << millionSamplesPerSecond(samples, [&] { estimatePi(samples, 1, omp_get_max_threads(), Generator::Threefry); }) << " Msamples/s\n";
+    cout << "option, Philox batched:         "
+         << millionSamplesPerSecond(samples, [&] { priceOption(option, samples, 1); }) << " Msamples/s\n";
+    cout << "option, Threefry batched:       "
+         << millionSamplesPerSecond(samples, [&] { priceOption(option, samples, 1, omp_get_max_threads(), Generator::Threefry); }) << " Msamples/s\n";
+}
+
+void test()
+{
+    testKnownAnswers();
+    testBatchMatchesScalar();
+    testReproducible();
+    testAccuracy();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
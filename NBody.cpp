@@ -0,0 +1,662 @@
+/*
+Gravitational N-body simulation: direct O(N^2) and Barnes-Hut O(N log N).
+
+Direct: every body interacts with every other. The inner loop over j is a SIMD
+reduction of the three acceleration components, the outer loop is 'omp for'.
+
+Barnes-Hut: bodies are sorted into an octree, and a far-away cell acts as one body
+at its center of mass when size / distance < theta.
+- the tree is built with tasks, like _sumTree in Task.cpp: a cell partitions its
+  bodies into 8 octants and builds every large octant in its own task
+- the cost of a body depends on how clustered its neighbourhood is, so the force
+  loop uses schedule(dynamic) or guided (set at run time with omp_set_schedule)
+- one parallel region runs all timesteps. Every phase (kick/drift, tree build,
+  forces, kick) is a worksharing construct, and its implicit barrier separates it
+  from the next phase.
+
+Integration is leapfrog (kick-drift-kick), which conserves energy well; energy drift
+measures the force error and the timestep. Units: G = 1, total mass 1, Plummer sphere.
+https://en.wikipedia.org/wiki/Barnes%E2%80%93Hut_simulation
+
+Usage: NBody [largest N]
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// softening length squared: keeps close encounters finite
+constexpr double EPS2 = 1e-4;
+
+// a cell with at most LEAF_SIZE bodies is not split
+constexpr int LEAF_SIZE = 8;
+
+// cells with fewer bodies than this are built by the task that found them
+constexpr int TASK_CUTOFF = 4096;
+
+// coincident bodies would otherwise split forever
+constexpr int MAX_DEPTH = 32;
+
+// structure of arrays, so the direct loop vectorizes
+struct Bodies
+{
+    vector<double> x, y, z, vx, vy, vz, ax, ay, az, m;
+
+    explicit Bodies(size_t n = 0)
+        : x(n), y(n), z(n), vx(n), vy(n), vz(n), ax(n), ay(n), az(n), m(n)
+    {
+    }
+
+    size_t size() const { return x.size(); }
+};
+
+// Plummer sphere in N-body units, sampled as in Aarseth, Henon and Wielen (1974)
+Bodies plummer(size_t n, uint64_t seed)
+{
+    Bodies b(n);
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double scale = 3 * numbers::pi / 16; // virial radius 1
+
+    auto randomDirection = [&](double length, double &x, double &y, double &z) {
+        const double cosTheta = 2 * uniform(rng) - 1, phi = 2 * numbers::pi * uniform(rng);
+        const double sinTheta = sqrt(1 - cosTheta * cosTheta);
+        x = length * sinTheta * cos(phi);
+        y = length * sinTheta * sin(phi);
+        z = length * cosTheta;
+    };
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        double r;
+        do
+            r = 1 / sqrt(pow(uniform(rng), -2.0 / 3.0) - 1);
+        while (r > 10);
+
+        // speed as a fraction q of the escape speed, q^2 (1 - q^2)^3.5 by rejection
+        double q, g;
+        do
+        {
+            q = uniform(rng);
+            g = 0.1 * uniform(rng);
+        } while (g > q * q * pow(1 - q * q, 3.5));
+        const double speed = q * sqrt(2.0) * pow(1 + r * r, -0.25);
+
+        randomDirection(r * scale, b.x[i], b.y[i], b.z[i]);
+        randomDirection(speed / sqrt(scale), b.vx[i], b.vy[i], b.vz[i]);
+        b.m[i] = 1.0 / n;
+    }
+
+    // put the center of mass at rest at the origin
+    double cx = 0, cy = 0, cz = 0, cvx = 0, cvy = 0, cvz = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cx += b.m[i] * b.x[i], cy += b.m[i] * b.y[i], cz += b.m[i] * b.z[i];
+        cvx += b.m[i] * b.vx[i], cvy += b.m[i] * b.vy[i], cvz += b.m[i] * b.vz[i];
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        b.x[i] -= cx, b.y[i] -= cy, b.z[i] -= cz;
+        b.vx[i] -= cvx, b.vy[i] -= cvy, b.vz[i] -= cvz;
+    }
+    return b;
+}
+
+// ---------------------------------------------------------------- direct
+
+// accelerations of all bodies, one worksharing loop (call inside a parallel region)
+void directForces(Bodies &b)
+{
+    const long long n = static_cast<long long>(b.size());
+    const double *x = b.x.data(), *y = b.y.data(), *z = b.z.data(), *m = b.m.data();
+
+    #pragma omp for schedule(static)
+    for (long long i = 0; i < n; ++i)
+    {
+        const double xi = x[i], yi = y[i], zi = z[i];
+        double ax = 0, ay = 0, az = 0;
+
+        // the body itself adds 0: dx = dy = dz = 0
+        #pragma omp simd reduction(+ : ax, ay, az)
+        for (long long j = 0; j < n; ++j)
+        {
+            const double dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+            const double inverse = 1 / sqrt(dx * dx + dy * dy + dz * dz + EPS2);
+            const double strength = m[j] * inverse * inverse * inverse;
+            ax += dx * strength;
+            ay += dy * strength;
+            az += dz * strength;
+        }
+        b.ax[i] = ax, b.ay[i] = ay, b.az[i] = az;
+    }
+}
+
+// potential energy summed over all pairs
+double directPotential(const Bodies &b)
+{
+    const long long n = static_cast<long long>(b.size());
+    double potential = 0;
+
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+ : potential)
+    for (long long i = 0; i < n; ++i)
+    {
+        for (long long j = i + 1; j < n; ++j)
+        {
+            const double dx = b.x[j] - b.x[i], dy = b.y[j] - b.y[i], dz = b.z[j] - b.z[i];
+            potential -= b.m[i] * b.m[j] / sqrt(dx * dx + dy * dy + dz * dz + EPS2);
+        }
+    }
+    return potential;
+}
+
+// ---------------------------------------------------------------- Barnes-Hut
+
+struct Cell
+{
+    double cx, cy, cz, half;       // the cube: center and half of its side
+    double mass = 0;               // total mass and center of mass
+    double mx = 0, my = 0, mz = 0;
+    int begin, end;                // its bodies are order[begin, end)
+    unique_ptr<Cell> children[8];  // all empty for a leaf
+    bool leaf = true;
+};
+
+struct Octree
+{
+    unique_ptr<Cell> root;
+    vector<int> order;   // body indexes, every cell's bodies contiguous
+    vector<int> scratch; // partition buffer
+};
+
+// splits 'cell' and builds its children, in tasks for the large ones
+void _buildCell(Cell *cell, const Bodies *b, Octree *tree, int depth)
+{
+    int *order = tree->order.data();
+    const int count = cell->end - cell->begin;
+
+    if (count > LEAF_SIZE && depth < MAX_DEPTH)
+    {
+        // partition into octants: bit 0 is x >= cx, bit 1 is y >= cy, bit 2 is z >= cz
+        auto octant = [&](int i) {
+            return int(b->x[i] >= cell->cx) | int(b->y[i] >= cell->cy) << 1 | int(b->z[i] >= cell->cz) << 2;
+        };
+        int counts[8] = {};
+        for (int k = cell->begin; k < cell->end; ++k)
+            ++counts[octant(order[k])];
+
+        int starts[9] = {cell->begin};
+        for (int o = 0; o < 8; ++o)
+            starts[o + 1] = starts[o] + counts[o];
+        int next[8];
+        copy(starts, starts + 8, next);
+        int *scratch = tree->scratch.data();
+        for (int k = cell->begin; k < cell->end; ++k)
+            scratch[next[octant(order[k])]++] = order[k];
+        copy(scratch + cell->begin, scratch + cell->end, order + cell->begin);
+
+        cell->leaf = false;
+        const double quarter = cell->half / 2;
+        for (int o = 0; o < 8; ++o)
+        {
+            if (counts[o] == 0)
+                continue;
+            cell->children[o] = make_unique<Cell>();
+            Cell *child = cell->children[o].get();
+            child->cx = cell->cx + (o & 1 ? quarter : -quarter);
+            child->cy = cell->cy + (o & 2 ? quarter : -quarter);
+            child->cz = cell->cz + (o & 4 ? quarter : -quarter);
+            child->half = quarter;
+            child->begin = starts[o];
+            child->end = starts[o + 1];
+
+            // children own disjoint ranges of 'order', so they can be built at the same time
+            #pragma omp task firstprivate(child, b, tree, depth) if (counts[o] > TASK_CUTOFF)
+            _buildCell(child, b, tree, depth + 1);
+        }
+        #pragma omp taskwait
+
+        // children in octant order, so the sums do not depend on the thread count
+        for (const auto &child : cell->children)
+        {
+            if (!child)
+                continue;
+            cell->mass += child->mass;
+            cell->mx += child->mass * child->mx;
+            cell->my += child->mass * child->my;
+            cell->mz += child->mass * child->mz;
+        }
+    }
+    else
+    {
+        for (int k = cell->begin; k < cell->end; ++k)
+        {
+            const int i = order[k];
+            cell->mass += b->m[i];
+            cell->mx += b->m[i] * b->x[i];
+            cell->my += b->m[i] * b->y[i];
+            cell->mz += b->m[i] * b->z[i];
+        }
+    }
+
+    if (cell->mass > 0)
+    {
+        cell->mx /= cell->mass;
+        cell->my /= cell->mass;
+        cell->mz /= cell->mass;
+    }
+}
+
+// builds the tree over the bounding cube [lo, hi]. call from one thread (single) of a team.
+void buildOctree(Octree &tree, const Bodies &b, const double lo[3], const double hi[3])
+{
+    const int n = static_cast<int>(b.size());
+    tree.order.resize(n);
+    tree.scratch.resize(n);
+    for (int i = 0; i < n; ++i)
+        tree.order[i] = i;
+
+    tree.root = make_unique<Cell>();
+    Cell *root = tree.root.get();
+    root->cx = (lo[0] + hi[0]) / 2, root->cy = (lo[1] + hi[1]) / 2, root->cz = (lo[2] + hi[2]) / 2;
+    root->half = max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]}) / 2 * 1.0001 + 1e-12;
+    root->begin = 0;
+    root->end = n;
+
+    #pragma omp taskgroup
+    {
+        _buildCell(root, &b, &tree, 0);
+    }
+}
+
+/*
+Calls visit(x, y, z, mass) for every body or cell that acts on body i, and returns
+how many there were. A cell is used as a whole when (size / distance)^2 < theta2.
+*/
+template <typename Visit>
+long long traverse(const Octree &tree, const Bodies &b, int i, double theta2, Visit visit)
+{
+    const double xi = b.x[i], yi = b.y[i], zi = b.z[i];
+    const Cell *stack[8 * MAX_DEPTH + 8];
+    int top = 0;
+    stack[top++] = tree.root.get();
+    long long interactions = 0;
+
+    while (top > 0)
+    {
+        const Cell *cell = stack[--top];
+        if (cell->leaf)
+        {
+            for (int k = cell->begin; k < cell->end; ++k)
+            {
+                const int j = tree.order[k];
+                if (j != i)
+                {
+                    visit(b.x[j] - xi, b.y[j] - yi, b.z[j] - zi, b.m[j]);
+                    ++interactions;
+                }
+            }
+            continue;
+        }
+
+        const double dx = cell->mx - xi, dy = cell->my - yi, dz = cell->mz - zi;
+        const double size = 2 * cell->half;
+        if (size * size < theta2 * (dx * dx + dy * dy + dz * dz))
+        {
+            visit(dx, dy, dz, cell->mass);
+            ++interactions;
+        }
+        else
+        {
+            for (const auto &child : cell->children)
+            {
+                if (child)
+                    stack[top++] = child.get();
+            }
+        }
+    }
+    return interactions;
+}
+
+/*
+Accelerations from the tree, one worksharing loop with the run-time schedule.
+Adds the number of interactions to 'interactions', which must be shared.
+*/
+void treeForces(const Octree &tree, Bodies &b, double theta, long long &interactions)
+{
+    const long long n = static_cast<long long>(b.size());
+    long long count = 0;
+
+    // in tree order, so neighbouring iterations walk the same cells
+    #pragma omp for schedule(runtime) nowait
+    for (long long k = 0; k < n; ++k)
+    {
+        const int i = tree.order[k];
+        double ax = 0, ay = 0, az = 0;
+        count += traverse(tree, b, i, theta * theta, [&](double dx, double dy, double dz, double mass) {
+            const double inverse = 1 / sqrt(dx * dx + dy * dy + dz * dz + EPS2);
+            const double strength = mass * inverse * inverse * inverse;
+            ax += dx * strength;
+            ay += dy * strength;
+            az += dz * strength;
+        });
+        b.ax[i] = ax, b.ay[i] = ay, b.az[i] = az;
+    }
+
+    #pragma omp atomic
+    interactions += count;
+    #pragma omp barrier
+}
+
+// bounding box of all bodies, then the tree. call from all threads of a team; lo and hi are shared.
+void buildOctreeInParallel(Octree &tree, const Bodies &b, double lo[3], double hi[3])
+{
+    const long long n = static_cast<long long>(b.size());
+
+    #pragma omp single
+    {
+        lo[0] = lo[1] = lo[2] = 1e300;
+        hi[0] = hi[1] = hi[2] = -1e300;
+    }
+
+    double myLo[3] = {1e300, 1e300, 1e300}, myHi[3] = {-1e300, -1e300, -1e300};
+    #pragma omp for nowait
+    for (long long i = 0; i < n; ++i)
+    {
+        myLo[0] = min(myLo[0], b.x[i]), myLo[1] = min(myLo[1], b.y[i]), myLo[2] = min(myLo[2], b.z[i]);
+        myHi[0] = max(myHi[0], b.x[i]), myHi[1] = max(myHi[1], b.y[i]), myHi[2] = max(myHi[2], b.z[i]);
+    }
+    #pragma omp critical(octreeBounds)
+    for (int d = 0; d < 3; ++d)
+    {
+        lo[d] = min(lo[d], myLo[d]);
+        hi[d] = max(hi[d], myHi[d]);
+    }
+    #pragma omp barrier
+
+    // the other threads run the build tasks while they wait at the barrier of single
+    #pragma omp single
+    buildOctree(tree, b, lo, hi);
+}
+
+// potential energy from the tree (each pair is seen from both sides, hence / 2)
+double treePotential(const Bodies &b, double theta)
+{
+    Octree tree;
+    double lo[3], hi[3];
+    const long long n = static_cast<long long>(b.size());
+    double potential = 0;
+
+    #pragma omp parallel
+    {
+        buildOctreeInParallel(tree, b, lo, hi);
+
+        #pragma omp for schedule(dynamic, 256) reduction(+ : potential)
+        for (long long i = 0; i < n; ++i)
+        {
+            traverse(tree, b, int(i), theta * theta, [&](double dx, double dy, double dz, double mass) {
+                potential -= b.m[i] * mass / sqrt(dx * dx + dy * dy + dz * dz + EPS2) / 2;
+            });
+        }
+    }
+    return potential;
+}
+
+// ---------------------------------------------------------------- simulation
+
+double kineticEnergy(const Bodies &b)
+{
+    const long long n = static_cast<long long>(b.size());
+    double kinetic = 0;
+    #pragma omp parallel for reduction(+ : kinetic)
+    for (long long i = 0; i < n; ++i)
+        kinetic += 0.5 * b.m[i] * (b.vx[i] * b.vx[i] + b.vy[i] * b.vy[i] + b.vz[i] * b.vz[i]);
+    return kinetic;
+}
+
+// exact potential up to 20'000 bodies, the tree with a small theta beyond
+double totalEnergy(const Bodies &b)
+{
+    return kineticEnergy(b) + (b.size() <= 20'000 ? directPotential(b) : treePotential(b, 0.3));
+}
+
+// half a kick (v += a dt / 2), optionally followed by a drift (x += v dt)
+void kick(Bodies &b, double dt, bool drift)
+{
+    const long long n = static_cast<long long>(b.size());
+
+    #pragma omp for schedule(static)
+    for (long long i = 0; i < n; ++i)
+    {
+        b.vx[i] += b.ax[i] * dt / 2, b.vy[i] += b.ay[i] * dt / 2, b.vz[i] += b.az[i] * dt / 2;
+        if (drift)
+            b.x[i] += b.vx[i] * dt, b.y[i] += b.vy[i] * dt, b.z[i] += b.vz[i] * dt;
+    }
+}
+
+// 'steps' leapfrog steps with direct forces. returns the number of interactions.
+long long simulateDirect(Bodies &b, int steps, double dt)
+{
+    #pragma omp parallel
+    {
+        directForces(b);
+        for (int step = 0; step < steps; ++step)
+        {
+            kick(b, dt, true);
+            directForces(b);
+            kick(b, dt, false);
+        }
+    }
+    return (steps + 1) * (long long)b.size() * b.size();
+}
+
+// 'steps' leapfrog steps with Barnes-Hut forces. returns the number of interactions.
+long long simulateBarnesHut(Bodies &b, int steps, double dt, double theta)
+{
+    Octree tree;
+    double lo[3], hi[3];
+    long long interactions = 0;
+
+    #pragma omp parallel
+    {
+        buildOctreeInParallel(tree, b, lo, hi);
+        treeForces(tree, b, theta, interactions);
+
+        for (int step = 0; step < steps; ++step)
+        {
+            kick(b, dt, true);
+            buildOctreeInParallel(tree, b, lo, hi);
+            treeForces(tree, b, theta, interactions);
+            kick(b, dt, false);
+        }
+    }
+    return interactions;
+}
+
+// ---------------------------------------------------------------- tests
+
+void testDirectForces()
+{
+    // two bodies at distance 1
+    Bodies b(2);
+    b.x = {0, 1};
+    b.m = {1, 2};
+    #pragma omp parallel
+    directForces(b);
+
+    const double expected = 1 / pow(1 + EPS2, 1.5);
+    assert(fabs(b.ax[0] - 2 * expected) < 1e-12 && fabs(b.ax[1] + expected) < 1e-12);
+    assert(b.ay[0] == 0 && b.az[1] == 0);
+}
+
+void testOctree()
+{
+    const Bodies b = plummer(20'000, 1);
+    Octree tree;
+    double lo[3], hi[3];
+    #pragma omp parallel
+    buildOctreeInParallel(tree, b, lo, hi);
+
+    // every body exactly once, and the root holds all the mass at the center of mass (the origin)
+    vector<int> sortedOrder = tree.order;
+    sort(sortedOrder.begin(), sortedOrder.end());
+    for (int i = 0; i < 20'000; ++i)
+        assert(sortedOrder[i] == i);
+    assert(fabs(tree.root->mass - 1) < 1e-12);
+    assert(fabs(tree.root->mx) < 1e-12 && fabs(tree.root->my) < 1e-12 && fabs(tree.root->mz) < 1e-12);
+
+    // every leaf's bodies lie inside its cube
+    vector<const Cell *> cells = {tree.root.get()};
+    while (!cells.empty())
+    {
+        const Cell *cell = cells.back();
+        cells.pop_back();
+        for (int k = cell->begin; k < cell->end; ++k)
+        {
+            const int i = tree.order[k];
+            assert(fabs(b.x[i] - cell->cx) <= cell->half && fabs(b.y[i] - cell->cy) <= cell->half &&
+                   fabs(b.z[i] - cell->cz) <= cell->half);
+        }
+        for (const auto &child : cell->children)
+            if (child)
+                cells.push_back(child.get());
+    }
+}
+
+void testTreeForces()
+{
+    Bodies direct = plummer(3000, 2), exact = direct, approximate = direct;
+    #pragma omp parallel
+    directForces(direct);
+
+    // theta = 0 opens every cell: the same sums as direct, in another order
+    simulateBarnesHut(exact, 0, 0, 0.0);
+    // theta = 0.5: about 1% error
+    simulateBarnesHut(approximate, 0, 0, 0.5);
+
+    double errorExact = 0, errorApproximate = 0, norm = 0;
+    for (size_t i = 0; i < direct.size(); ++i)
+    {
+        auto square = [](double x, double y, double z) { return x * x + y * y + z * z; };
+        norm += square(direct.ax[i], direct.ay[i], direct.az[i]);
+        errorExact += square(exact.ax[i] - direct.ax[i], exact.ay[i] - direct.ay[i], exact.az[i] - direct.az[i]);
+        errorApproximate += square(approximate.ax[i] - direct.ax[i], approximate.ay[i] - direct.ay[i],
+                                   approximate.az[i] - direct.az[i]);
+    }
+    assert(sqrt(errorExact / norm) < 1e-12);
+    assert(sqrt(errorApproximate / norm) < 0.02);
+}
+
+void testThreadCounts()
+{
+    // the tree and the per-body sums do not depend on the team, so neither do the results
+    const int saved = omp_get_max_threads();
+    Bodies reference = plummer(10'000, 3);
+    omp_set_num_threads(1);
+    simulateBarnesHut(reference, 2, 1e-3, 0.5);
+
+    for (int threads : {2, 3, 8})
+    {
+        omp_set_num_threads(threads);
+        Bodies b = plummer(10'000, 3);
+        simulateBarnesHut(b, 2, 1e-3, 0.5);
+        assert(b.x == reference.x && b.vz == reference.vz);
+    }
+    omp_set_num_threads(saved);
+}
+
+void testEnergyConservation()
+{
+    Bodies direct = plummer(500, 4), tree = direct;
+    const double start = totalEnergy(direct);
+    assert(start < 0); // bound
+
+    simulateDirect(direct, 100, 1e-3);
+    simulateBarnesHut(tree, 100, 1e-3, 0.5);
+    assert(fabs((totalEnergy(direct) - start) / start) < 1e-4);
+    assert(fabs((totalEnergy(tree) - start) / start) < 1e-3);
+}
+
+// ---------------------------------------------------------------- benchmark
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output (1 core; pass a larger N, up to 10^7, for the bigger runs):
+4 threads, dt 0.001, theta 0.5
+N	method			steps	interactions/s	energy drift
+10000	direct			10	2.71189e+08	3.04298e-08
+10000	barnes-hut dynamic	10	1.59546e+08	1.73255e-07
+10000	barnes-hut guided	10	1.47244e+08	1.73255e-07
+10000	barnes-hut static	10	1.4342e+08	1.73255e-07
+100000	barnes-hut dynamic	3	1.0811e+08	2.84562e-07
+100000	barnes-hut guided	3	1.29295e+08	2.84562e-07
+100000	barnes-hut static	3	1.23685e+08	2.84562e-07
+*/
+void benchmark(size_t largest)
+{
+    const double dt = 1e-3, theta = 0.5;
+    cout << omp_get_max_threads() << " threads, dt " << dt << ", theta " << theta << '\n';
+    cout << "N\tmethod\t\t\tsteps\tinteractions/s\tenergy drift\n";
+
+    for (size_t n = 10'000; n <= largest; n *= 10)
+    {
+        const Bodies initial = plummer(n, 5);
+        const double energy = totalEnergy(initial);
+        const int steps = n <= 10'000 ? 10 : n <= 100'000 ? 3 : 1;
+
+        auto row = [&](const char *method, auto simulate) {
+            Bodies b = initial;
+            long long interactions = 0;
+            const double seconds = secondsFor([&] { interactions = simulate(b); });
+            cout << n << '\t' << method << '\t' << steps << '\t' << interactions / seconds << '\t'
+                 << fabs((totalEnergy(b) - energy) / energy) << '\n';
+        };
+
+        if (n <= 30'000)
+            row("direct\t\t", [&](Bodies &b) { return simulateDirect(b, steps, dt); });
+
+        omp_set_schedule(omp_sched_dynamic, 256);
+        row("barnes-hut dynamic", [&](Bodies &b) { return simulateBarnesHut(b, steps, dt, theta); });
+        omp_set_schedule(omp_sched_guided, 0);
+        row("barnes-hut guided", [&](Bodies &b) { return simulateBarnesHut(b, steps, dt, theta); });
+        omp_set_schedule(omp_sched_static, 0);
+        row("barnes-hut static", [&](Bodies &b) { return simulateBarnesHut(b, steps, dt, theta); });
+    }
+}
+
+void test()
+{
+    testDirectForces();
+    testOctree();
+    testTreeForces();
+    testThreadCounts();
+    testEnergyConservation();
+}
+
+int main(int argc, char *argv[])
+{
+    test();
+    benchmark(argc > 1 ? stoull(argv[1]) : 100'000);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,248 @@
+/*
+Nested parallelism: a parallel region inside another parallel region.
+By default the inner region runs with a team of 1 thread. Nesting must be
+enabled by allowing more than one active level:
+omp_set_max_active_levels(2);
+
+Task.cpp warns that nested parallel regions hinder performance. This file
+measures that claim on a batch of independent matrix products by comparing:
+1. inner:   loop over the batch serially and parallelize each product's rows
+            (the approach of matrixMultiply in ParallelFor.cpp)
+2. flat:    one 'parallel for' over the batch, each product is serial
+3. nested:  an outer team per socket (or place partition) over the batch,
+            each with an inner team over the rows. proc_bind(spread) keeps the
+            outer threads apart and proc_bind(close) keeps each inner team on
+            its own socket.
+4. taskloop: one task per product, with the inner loop vectorized with simd
+
+Few large products favor parallelizing inside a product; many small ones favor
+the batch loop. Nesting is in between when a batch is smaller than the thread count.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// one N x N row-major matrix
+using Matrix = vector<double>;
+
+struct Batch
+{
+    int n{};
+    vector<Matrix> A, B, C;
+
+    Batch(int count, int n)
+        : n(n), A(count, Matrix(size_t(n) * n)), B(count, Matrix(size_t(n) * n)), C(count, Matrix(size_t(n) * n))
+    {
+        for (int b = 0; b < count; ++b)
+        {
+            for (int i = 0; i < n * n; ++i)
+            {
+                A[b][i] = (i % 7) - 3 + b;
+                B[b][i] = (i % 5) - 2;
+            }
+        }
+    }
+
+    int size() const { return static_cast<int>(A.size()); }
+};
+
+// rows [rowBegin, rowEnd) of C = A * B. i-k-j order keeps the inner loop unit-stride.
+inline void multiplyRows(const double *A, const double *B, double *C, int n, int rowBegin, int rowEnd)
+{
+    for (int i = rowBegin; i < rowEnd; ++i)
+    {
+        double *c = C + size_t(i) * n;
+        fill(c, c + n, 0.0);
+        for (int k = 0; k < n; ++k)
+        {
+            const double a = A[size_t(i) * n + k];
+            const double *b = B + size_t(k) * n;
+
+            #pragma omp simd
+            for (int j = 0; j < n; ++j)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+void batchInner(Batch &batch)
+{
+    const int n = batch.n;
+    for (int b = 0; b < batch.size(); ++b)
+    {
+        const double *A = batch.A[b].data();
+        const double *B = batch.B[b].data();
+        double *C = batch.C[b].data();
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; ++i)
+            multiplyRows(A, B, C, n, i, i + 1);
+    }
+}
+
+void batchFlat(Batch &batch)
+{
+    const int n = batch.n;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < batch.size(); ++b)
+        multiplyRows(batch.A[b].data(), batch.B[b].data(), batch.C[b].data(), n, 0, n);
+}
+
+// number of outer teams: one per place if OMP_PLACES is set (e.g. OMP_PLACES=sockets), otherwise 2
+int outerTeamCount()
+{
+    const int places = omp_get_num_places();
+    const int threads = omp_get_max_threads();
+    return clamp(places > 1 ? places : 2, 1, threads);
+}
+
+void batchNested(Batch &batch)
+{
+    const int n = batch.n;
+    const int outer = outerTeamCount();
+    const int inner = max(1, omp_get_max_threads() / outer);
+
+    const int previousLevels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+
+    #pragma omp parallel for num_threads(outer) proc_bind(spread) schedule(dynamic)
+    for (int b = 0; b < batch.size(); ++b)
+    {
+        const double *A = batch.A[b].data();
+        const double *B = batch.B[b].data();
+        double *C = batch.C[b].data();
+
+        // inner team stays on the outer thread's place
+        #pragma omp parallel for num_threads(inner) proc_bind(close) schedule(static)
+        for (int i = 0; i < n; ++i)
+            multiplyRows(A, B, C, n, i, i + 1);
+    }
+
+    omp_set_max_active_levels(previousLevels);
+}
+
+void batchTaskloop(Batch &batch)
+{
+    const int n = batch.n;
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            // one task per product. idle threads steal the remaining tasks.
+            #pragma omp taskloop grainsize(1)
+            for (int b = 0; b < batch.size(); ++b)
+                multiplyRows(batch.A[b].data(), batch.B[b].data(), batch.C[b].data(), n, 0, n);
+        }
+    }
+}
+
+struct Strategy
+{
+    const char *name;
+    void (*run)(Batch &);
+};
+
+const Strategy STRATEGIES[] = {
+    {"inner", batchInner},
+    {"flat", batchFlat},
+    {"nested", batchNested},
+    {"taskloop", batchTaskloop},
+};
+
+void testStrategies()
+{
+    Batch expected(5, 19);
+    for (int b = 0; b < expected.size(); ++b)
+        multiplyRows(expected.A[b].data(), expected.B[b].data(), expected.C[b].data(), expected.n, 0, expected.n);
+
+    // spot check one product against the textbook triple loop
+    const int n = expected.n;
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < n; ++k)
+                sum += expected.A[3][i * n + k] * expected.B[3][k * n + j];
+            assert(expected.C[3][i * n + j] == sum);
+        }
+    }
+
+    for (const Strategy &s : STRATEGIES)
+    {
+        Batch batch(5, 19);
+        s.run(batch);
+        assert(batch.C == expected.C);
+    }
+
+    // nesting is restored to its previous setting
+    const int levels = omp_get_max_active_levels();
+    batchNested(expected);
+    assert(omp_get_max_active_levels() == levels);
+}
+
+/* Sample output (times in ms, 4 threads):
+batch  N     inner    flat     nested   taskloop  winner
+1024   32    34.1938  16.0828  39.5557  19.2511   flat
+256    64    48.0669  42.3705  33.7338  41.9463   nested
+32     128   34.1065  34.0063  27.4503  27.4302   taskloop
+4      256   29.1453  31.1864  30.6206  24.0131   taskloop
+*/
+void benchmark()
+{
+    // each combination does about the same number of flops
+    const pair<int, int> shapes[] = {{1024, 32}, {256, 64}, {32, 128}, {4, 256}};
+
+    cout << "Threads: " << omp_get_max_threads() << ", outer teams for nested: " << outerTeamCount() << '\n';
+    cout << "batch  N     inner    flat     nested   taskloop  winner\n";
+    for (auto [count, n] : shapes)
+    {
+        Batch batch(count, n);
+        cout << count << "\t" << n << "\t";
+
+        double best = 1e30;
+        const char *winner = "";
+        for (const Strategy &s : STRATEGIES)
+        {
+            s.run(batch); // warm-up
+
+            auto start = chrono::steady_clock::now();
+            s.run(batch);
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+            cout << elapsed.count() << "\t";
+            if (elapsed.count() < best)
+            {
+                best = elapsed.count();
+                winner = s.name;
+            }
+        }
+        cout << winner << '\n';
+    }
+}
+
+void test()
+{
+    testStrategies();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,546 @@
+/*
+Overhead of OpenMP constructs, in the style of the EPCC microbenchmarks
+(syncbench and schedbench):
+https://www.epcc.ed.ac.uk/research/computing/performance-characterisation-and-benchmarking/epcc-openmp-micro-benchmark-suite
+
+Each construct is run innerReps times around a short delay(). The same delays are
+also run without the construct (the reference). The overhead of one construct is:
+    (test time - reference time) / innerReps
+
+This is repeated outerReps times to get a distribution (min, median, p90, max),
+because scheduling noise makes single measurements unreliable.
+
+Runtimes keep a pool of threads between regions, so 'parallel' does not create
+threads each time (see Compiler.md). Idle threads first spin and then sleep.
+How long they spin is set by environment variables, read once at startup:
+- OMP_WAIT_POLICY=active|passive (standard)
+- GOMP_SPINCOUNT=<n>            (GCC libgomp)
+- KMP_BLOCKTIME=<ms>|infinite   (LLVM and Intel libomp)
+Spinning makes the next region start faster but burns CPU that other processes
+(or oversubscribed threads) could use. The policy comparison re-runs this program
+with each setting.
+
+Usage: Overhead [maxThreads]
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+
+// length of the work inside each construct, as in EPCC
+constexpr double DELAY_SECONDS = 0.1e-6;
+
+// target duration of one sample; innerReps is chosen to reach it
+constexpr double SAMPLE_SECONDS = 2e-3;
+
+// loop iterations per thread in the schedule benchmark
+constexpr int ITERS_PER_THREAD = 128;
+
+int delayLength = 0;
+
+void delay(int length)
+{
+    volatile double a = 0.0; // volatile so the loop is not removed
+    for (int i = 0; i < length; ++i)
+        a = a + i;
+}
+
+// sets delayLength so that delay(delayLength) takes about 'seconds'
+void calibrateDelay(double seconds)
+{
+    const int probeLength = 10'000;
+    double best = 1e30;
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        const double start = omp_get_wtime();
+        delay(probeLength);
+        best = min(best, omp_get_wtime() - start);
+    }
+    delayLength = max(1, int(seconds / best * probeLength));
+}
+
+struct Stats
+{
+    double min, median, p90, max, mean;
+};
+
+Stats summarize(vector<double> samples)
+{
+    assert(!samples.empty());
+    sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[size_t(q * (samples.size() - 1) + 0.5)]; };
+
+    double sum = 0.0;
+    for (double s : samples)
+        sum += s;
+    return {samples.front(), at(0.5), at(0.9), samples.back(), sum / samples.size()};
+}
+
+/*
+Test kernels, one per construct. Each runs innerReps instances of the construct and
+returns how many times the body ran, which the tests check.
+*/
+
+long long parallelKernel(int innerReps)
+{
+    for (int r = 0; r < innerReps; ++r)
+    {
+        #pragma omp parallel
+        delay(delayLength);
+    }
+    return innerReps;
+}
+
+long long forKernel(int innerReps)
+{
+    long long count = 0;
+    #pragma omp parallel
+    {
+        const int threads = omp_get_num_threads();
+        for (int r = 0; r < innerReps; ++r)
+        {
+            #pragma omp for
+            for (int i = 0; i < threads; ++i)
+                delay(delayLength);
+        }
+
+        #pragma omp single
+        count = 1LL * innerReps * threads;
+    }
+    return count;
+}
+
+long long parallelForKernel(int innerReps)
+{
+    const int threads = omp_get_max_threads();
+    for (int r = 0; r < innerReps; ++r)
+    {
+        #pragma omp parallel for
+        for (int i = 0; i < threads; ++i)
+            delay(delayLength);
+    }
+    return 1LL * innerReps * threads;
+}
+
+long long barrierKernel(int innerReps)
+{
+    #pragma omp parallel
+    {
+        for (int r = 0; r < innerReps; ++r)
+        {
+            delay(delayLength);
+            #pragma omp barrier
+        }
+    }
+    return innerReps;
+}
+
+long long singleKernel(int innerReps)
+{
+    long long count = 0;
+    #pragma omp parallel
+    {
+        for (int r = 0; r < innerReps; ++r)
+        {
+            // implied barrier at the end, so count is never updated concurrently
+            #pragma omp single
+            {
+                delay(delayLength);
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+long long masterKernel(int innerReps)
+{
+    long long count = 0;
+    #pragma omp parallel
+    {
+        for (int r = 0; r < innerReps; ++r)
+        {
+            // no barrier: the other threads skip ahead
+            #pragma omp master
+            {
+                delay(delayLength);
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+long long criticalKernel(int innerReps)
+{
+    long long count = 0;
+    #pragma omp parallel
+    {
+        const int reps = innerReps / omp_get_num_threads();
+        for (int r = 0; r < reps; ++r)
+        {
+            #pragma omp critical
+            {
+                delay(delayLength);
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+long long atomicKernel(int innerReps)
+{
+    long long count = 0;
+    #pragma omp parallel
+    {
+        const int reps = innerReps / omp_get_num_threads();
+        for (int r = 0; r < reps; ++r)
+        {
+            #pragma omp atomic
+            ++count;
+        }
+    }
+    return count;
+}
+
+long long reductionKernel(int innerReps)
+{
+    long long count = 0;
+    for (int r = 0; r < innerReps; ++r)
+    {
+        #pragma omp parallel reduction(+ : count)
+        {
+            delay(delayLength);
+            ++count;
+        }
+    }
+    return count;
+}
+
+// uses schedule(runtime), so the kind and chunk size come from omp_set_schedule
+long long scheduleKernel(int innerReps)
+{
+    long long count = 0;
+    #pragma omp parallel
+    {
+        const int iterations = ITERS_PER_THREAD * omp_get_num_threads();
+        for (int r = 0; r < innerReps; ++r)
+        {
+            #pragma omp for schedule(runtime)
+            for (int i = 0; i < iterations; ++i)
+                delay(delayLength);
+        }
+
+        #pragma omp single
+        count = 1LL * innerReps * iterations;
+    }
+    return count;
+}
+
+// references: the same delays on one thread, without the construct
+
+long long delayReference(int innerReps)
+{
+    for (int r = 0; r < innerReps; ++r)
+        delay(delayLength);
+    return innerReps;
+}
+
+long long atomicReference(int innerReps)
+{
+    volatile long long count = 0;
+    for (int r = 0; r < innerReps; ++r)
+        count = count + 1;
+    return count;
+}
+
+long long scheduleReference(int innerReps)
+{
+    for (int r = 0; r < innerReps * ITERS_PER_THREAD; ++r)
+        delay(delayLength);
+    return innerReps;
+}
+
+using Kernel = long long (*)(int innerReps);
+
+struct Construct
+{
+    const char *name;
+    Kernel test;
+    Kernel reference;
+};
+
+const Construct SYNC_CONSTRUCTS[] = {
+    {"parallel", parallelKernel, delayReference},
+    {"for", forKernel, delayReference},
+    {"parallel for", parallelForKernel, delayReference},
+    {"barrier", barrierKernel, delayReference},
+    {"single", singleKernel, delayReference},
+    {"master", masterKernel, delayReference},
+    {"critical", criticalKernel, delayReference},
+    {"atomic", atomicKernel, atomicReference},
+    {"reduction", reductionKernel, delayReference},
+};
+
+double timeKernel(Kernel kernel, int innerReps)
+{
+    const double start = omp_get_wtime();
+    kernel(innerReps);
+    return omp_get_wtime() - start;
+}
+
+// overhead of one construct instance in microseconds, outerReps samples
+Stats measureOverhead(const Construct &construct, int outerReps)
+{
+    // pick innerReps so that one sample takes about SAMPLE_SECONDS
+    const int probeReps = 16;
+    const double probe = max(timeKernel(construct.test, probeReps), 1e-9);
+    const int innerReps = max(probeReps, int(SAMPLE_SECONDS / probe * probeReps));
+
+    double reference = 0.0;
+    for (int rep = 0; rep < outerReps; ++rep)
+        reference += timeKernel(construct.reference, innerReps);
+    reference /= outerReps;
+
+    vector<double> samples;
+    for (int rep = 0; rep < outerReps; ++rep)
+        samples.push_back((timeKernel(construct.test, innerReps) - reference) / innerReps * 1e6);
+    return summarize(samples);
+}
+
+void printRow(const string &name, const Stats &s)
+{
+    printf("%-22s %9.3f %9.3f %9.3f %9.3f\n", name.c_str(), s.min, s.median, s.p90, s.max);
+}
+
+void printHeader(const string &title)
+{
+    printf("%-22s %9s %9s %9s %9s\n", title.c_str(), "min us", "median", "p90", "max");
+}
+
+void syncBench(int threads, int outerReps)
+{
+    omp_set_num_threads(threads);
+    printHeader(to_string(threads) + " threads");
+    for (const Construct &c : SYNC_CONSTRUCTS)
+        printRow(c.name, measureOverhead(c, outerReps));
+}
+
+void scheduleBench(int threads, int outerReps)
+{
+    omp_set_num_threads(threads);
+    printHeader("schedule, " + to_string(threads) + " thr");
+
+    const pair<omp_sched_t, const char *> kinds[] = {
+        {omp_sched_static, "static"}, {omp_sched_dynamic, "dynamic"}, {omp_sched_guided, "guided"}};
+    const Construct construct{"", scheduleKernel, scheduleReference};
+
+    for (auto [kind, name] : kinds)
+    {
+        for (int chunk : {1, 8, 64})
+        {
+            omp_set_schedule(kind, chunk);
+            printRow(string(name) + ", " + to_string(chunk), measureOverhead(construct, outerReps));
+        }
+    }
+
+    omp_set_schedule(omp_sched_auto, 0);
+    printRow("auto", measureOverhead(construct, outerReps));
+}
+
+// a short run for the wait policy comparison: median overheads on one line
+void childBench(int threads)
+{
+    omp_set_num_threads(threads);
+    for (int i : {0, 3, 6}) // parallel, barrier, critical
+        printf("%9.3f", measureOverhead(SYNC_CONSTRUCTS[i], 11).median);
+    printf("\n");
+}
+
+void setEnv(const char *name, const char *value)
+{
+#ifdef _WIN32
+    _putenv_s(name, value ? value : "");
+#else
+    if (value)
+        setenv(name, value, 1);
+    else
+        unsetenv(name);
+#endif
+}
+
+/*
+Environment variables are only read when the runtime starts, so each setting runs
+this program again as a child process. GOMP_SPINCOUNT only affects libgomp and
+KMP_BLOCKTIME only affects libomp; the other one is ignored.
+*/
+void compareWaitPolicies(const char *self, int threads)
+{
+    const pair<const char *, const char *> settings[] = {
+        {nullptr, nullptr},
+        {"OMP_WAIT_POLICY", "active"},
+        {"OMP_WAIT_POLICY", "passive"},
+        {"GOMP_SPINCOUNT", "0"},
+        {"GOMP_SPINCOUNT", "10000000"},
+        {"KMP_BLOCKTIME", "0"},
+        {"KMP_BLOCKTIME", "infinite"},
+    };
+
+    printf("%-28s %9s %9s %9s  (median us, %d threads)\n", "wait policy", "parallel", "barrier", "critical", threads);
+    for (auto [name, value] : settings)
+    {
+        const char *saved = name ? getenv(name) : nullptr;
+        const string savedValue = saved ? saved : "";
+        if (name)
+            setEnv(name, value);
+
+        const string command = "\"" + string(self) + "\" --child " + to_string(threads);
+        string output;
+        if (FILE *pipe = popen(command.c_str(), "r"))
+        {
+            char buffer[256];
+            while (fgets(buffer, sizeof(buffer), pipe))
+                output += buffer;
+            pclose(pipe);
+        }
+
+        if (name)
+            setEnv(name, saved ? savedValue.c_str() : nullptr);
+
+        const string label = name ? string(name) + "=" + value : "default";
+        printf("%-28s %s", label.c_str(), output.empty() ? "failed to run\n" : output.c_str());
+    }
+}
+
+void testSummarize()
+{
+    Stats s = summarize({5.0, 1.0, 4.0, 2.0, 3.0});
+    assert(s.min == 1.0 && s.median == 3.0 && s.max == 5.0 && s.mean == 3.0);
+    assert(s.p90 == 5.0);
+
+    s = summarize({7.0});
+    assert(s.min == 7.0 && s.median == 7.0 && s.p90 == 7.0 && s.max == 7.0);
+}
+
+void testKernels()
+{
+    const int savedThreads = omp_get_max_threads();
+    omp_set_num_threads(3);
+    const int reps = 64;
+
+    assert(parallelKernel(reps) == reps);
+    assert(forKernel(reps) == reps * 3);
+    assert(parallelForKernel(reps) == reps * 3);
+    assert(barrierKernel(reps) == reps);
+    assert(singleKernel(reps) == reps);
+    assert(masterKernel(reps) == reps);
+    assert(criticalKernel(reps) == 63); // 21 per thread
+    assert(atomicKernel(reps) == 63);
+    assert(reductionKernel(reps) == reps * 3);
+
+    omp_set_schedule(omp_sched_dynamic, 8);
+    assert(scheduleKernel(2) == 2 * ITERS_PER_THREAD * 3);
+
+    assert(atomicReference(reps) == reps);
+    omp_set_num_threads(savedThreads);
+}
+
+/* Sample output (1 core, so above 1 thread the times include the other threads' delays):
+delay(41) = 0.1 us
+1 threads                 min us    median       p90       max
+parallel                   0.275     0.291     0.314     0.338
+for                        0.188     0.200     0.233     0.243
+parallel for               0.293     0.307     0.366     0.435
+barrier                    0.186     0.196     0.210     0.343
+single                     0.193     0.197     0.216     0.376
+master                    -0.002     0.001     0.004     0.006
+critical                   0.008     0.012     0.017     0.020
+atomic                     0.006     0.007     0.008     0.008
+reduction                  0.271     0.388     0.404     0.411
+...
+4 threads                 min us    median       p90       max
+parallel                  14.594    15.532    47.153    69.209
+for                        7.478     7.706     7.945     7.959
+parallel for              14.507    15.084    15.568    26.112
+barrier                    7.266     7.556     8.007     9.470
+single                     7.031     7.130     7.183     7.350
+master                     0.005     0.006     0.011     0.014
+critical                   0.011     0.014     0.021     0.022
+atomic                     0.012     0.014     0.015     0.018
+reduction                 14.335    14.756    22.261    39.835
+schedule, 4 thr           min us    median       p90       max
+static, 1                 29.711    30.183    31.186    34.351
+static, 8                 24.386    25.195    26.853    72.829
+static, 64                24.184    26.095    27.879    29.943
+dynamic, 1                26.485    29.173    31.044    33.365
+dynamic, 8                24.125    25.931    28.509    28.891
+dynamic, 64               24.778    26.976    30.202    36.861
+guided, 1                 24.067    24.420    26.375    28.596
+guided, 8                 24.358    25.523    29.281    44.411
+guided, 64                24.467    25.186    27.397    39.201
+auto                      22.792    24.414    26.015    27.420
+wait policy                   parallel   barrier  critical  (median us, 4 threads)
+default                         14.564    7.420    0.016
+OMP_WAIT_POLICY=active          90.211   48.074    0.339
+OMP_WAIT_POLICY=passive          7.156    3.652    0.009
+GOMP_SPINCOUNT=0                 7.066    3.590    0.009
+GOMP_SPINCOUNT=10000000         14.567    7.514    0.016
+KMP_BLOCKTIME=0                 14.582    7.617    0.016
+KMP_BLOCKTIME=infinite          17.420    7.701    0.022
+*/
+void benchmark(int maxThreads)
+{
+    calibrateDelay(DELAY_SECONDS);
+    printf("delay(%d) = %g us\n", delayLength, DELAY_SECONDS * 1e6);
+
+    const int outerReps = 21;
+    // powers of two, then maxThreads
+    for (int threads = 1;; threads = min(2 * threads, maxThreads))
+    {
+        syncBench(threads, outerReps);
+        if (threads >= maxThreads)
+            break;
+    }
+    scheduleBench(maxThreads, outerReps);
+}
+
+void test()
+{
+    testSummarize();
+    testKernels();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2 && string(argv[1]) == "--child")
+    {
+        calibrateDelay(DELAY_SECONDS);
+        childBench(atoi(argv[2]));
+        return 0;
+    }
+
+    const int maxThreads = argc > 1 ? atoi(argv[1]) : max(4, omp_get_max_threads());
+
+    test();
+    benchmark(maxThreads);
+    compareWaitPolicies(argv[0], maxThreads);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -17,6 +17,7 @@ using namespace std;
 void testLoopDependence()
 {
     // this poorly written example has iteration dependence on the 'j' variable
+    // (Wavefront.cpp parallelizes a real loop-carried dependence: DP tables)
     int result = 0;
     int j = 5;
     for (int i = 0; i < 1000; ++i)
@@ -0,0 +1,371 @@
+/*
+Sections vs tasks: measured overhead, and parallel_invoke(fns...) that picks one.
+
+Sections are often said to have lower overhead than tasks but to be rigid.
+The benchmark checks this: N units of work (N = 2..256) run as N sections and as N
+tasks, with uniform and with skewed costs. The overhead per unit is
+    (time - ideal time) / N,   ideal = max(total work / cores, longest unit)
+
+How sections are handed out is implementation defined. libgomp gives the next
+section to whichever thread asks (like schedule(dynamic, 1)), LLVM's libomp lowers
+them to a loop with schedule(static), which is what makes skewed costs expensive.
+
+parallel_invoke(fns...) runs every callable once, in parallel, as tasks: the benchmark
+found them no slower than sections, even for a few callables of uniform cost (libgomp,
+measured on 1 core only, so with 4 threads time-slicing).
+parallel_invoke(InvokeStrategy::Sections, fns...) asks for sections instead, e.g. for a
+runtime where they measure cheaper. Tasks are still used if sections can't work:
+- more callables than threads (or than MAX_SECTIONS)
+- called from inside a parallel region (sections would need the whole team to reach them)
+Only ask for sections when the costs are uniform: libomp's static split makes one
+thread run every section it was given, however long the others take.
+
+Sections cannot be created in a loop: every '#pragma omp section' is written in the
+source. The SECTIONS_n macros below write n of them with _Pragma.
+
+Usage: ParallelInvoke
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// n consecutive sections calling unit(i), unit(i + 1), ...
+#define SECTION(i) _Pragma("omp section") unit(i);
+#define SECTIONS_2(i) SECTION(i) SECTION(i + 1)
+#define SECTIONS_4(i) SECTIONS_2(i) SECTIONS_2(i + 2)
+#define SECTIONS_8(i) SECTIONS_4(i) SECTIONS_4(i + 4)
+#define SECTIONS_16(i) SECTIONS_8(i) SECTIONS_8(i + 8)
+#define SECTIONS_32(i) SECTIONS_16(i) SECTIONS_16(i + 16)
+#define SECTIONS_64(i) SECTIONS_32(i) SECTIONS_32(i + 32)
+#define SECTIONS_128(i) SECTIONS_64(i) SECTIONS_64(i + 64)
+#define SECTIONS_256(i) SECTIONS_128(i) SECTIONS_128(i + 128)
+
+// most callables parallel_invoke runs as sections
+constexpr int MAX_SECTIONS = 8;
+
+enum class InvokeStrategy
+{
+    Sections,
+    Tasks,
+};
+
+// the strategy parallel_invoke uses: 'preferred' unless it is sections and they can't work
+InvokeStrategy chooseInvoke(int callables, int threads, InvokeStrategy preferred, bool inParallel)
+{
+    if (preferred == InvokeStrategy::Tasks || inParallel || callables > threads || callables > MAX_SECTIONS)
+        return InvokeStrategy::Tasks;
+    return InvokeStrategy::Sections;
+}
+
+template <typename... Fns>
+InvokeStrategy parallel_invoke(InvokeStrategy preferred, Fns &&...fns)
+{
+    constexpr int N = sizeof...(Fns);
+    static_assert(N > 0);
+
+    // calls the i-th callable
+    auto call = [&](int i) {
+        int k = 0;
+        ((k++ == i ? (void)fns() : (void)0), ...);
+    };
+
+    const bool inParallel = omp_in_parallel();
+    const InvokeStrategy strategy = chooseInvoke(N, omp_get_max_threads(), preferred, inParallel);
+
+    if (strategy == InvokeStrategy::Sections)
+    {
+        if constexpr (N <= MAX_SECTIONS)
+        {
+            // sections past the last callable are empty
+            auto unit = [&](int i) {
+                if (i < N)
+                    call(i);
+            };
+
+            #pragma omp parallel num_threads(N)
+            {
+                #pragma omp sections
+                {
+                    SECTIONS_8(0)
+                }
+            }
+        }
+        return strategy;
+    }
+
+    // one task per callable. pointers, so the tasks do not copy the callables.
+    auto spawn = [](auto *fn) {
+        #pragma omp task firstprivate(fn)
+        (*fn)();
+    };
+
+    if (inParallel)
+    {
+        #pragma omp taskgroup
+        {
+            (spawn(&fns), ...);
+        }
+    }
+    else
+    {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                (spawn(&fns), ...);
+            } // the barrier at the end of single waits for the tasks
+        }
+    }
+    return strategy;
+}
+
+template <typename... Fns>
+InvokeStrategy parallel_invoke(Fns &&...fns)
+{
+    return parallel_invoke(InvokeStrategy::Tasks, forward<Fns>(fns)...);
+}
+
+void testChooseInvoke()
+{
+    const InvokeStrategy sections = InvokeStrategy::Sections, tasks = InvokeStrategy::Tasks;
+    assert(chooseInvoke(2, 4, tasks, false) == tasks);
+    assert(chooseInvoke(2, 4, sections, false) == sections);
+    assert(chooseInvoke(4, 4, sections, false) == sections);
+    assert(chooseInvoke(5, 4, sections, false) == tasks);
+    assert(chooseInvoke(2, 4, sections, true) == tasks);
+    assert(chooseInvoke(MAX_SECTIONS + 1, 64, sections, false) == tasks);
+}
+
+void testParallelInvoke()
+{
+    const int saved = omp_get_max_threads();
+    omp_set_num_threads(4);
+
+    // every callable runs exactly once, whichever strategy is used
+    int a = 0, b = 0, c = 0;
+    assert(parallel_invoke([&] { ++a; }, [&] { ++b; }, [&] { ++c; }) == InvokeStrategy::Tasks);
+    assert(a == 1 && b == 1 && c == 1);
+
+    assert(parallel_invoke(InvokeStrategy::Sections, [&] { ++a; }, [&] { ++b; }) == InvokeStrategy::Sections);
+    assert(a == 2 && b == 2 && c == 1);
+
+    // more callables than threads
+    int counts[6] = {};
+    assert(parallel_invoke(InvokeStrategy::Sections, [&] { ++counts[0]; }, [&] { ++counts[1]; }, [&] { ++counts[2]; },
+                           [&] { ++counts[3]; }, [&] { ++counts[4]; }, [&] { ++counts[5]; }) == InvokeStrategy::Tasks);
+    for (int count : counts)
+        assert(count == 1);
+
+    // nested: every thread of an outer region runs its own pair as tasks
+    atomic<int> calls = 0;
+    #pragma omp parallel num_threads(3)
+    {
+        assert(parallel_invoke(InvokeStrategy::Sections, [&] { ++calls; }, [&] { ++calls; }) == InvokeStrategy::Tasks);
+    }
+    assert(calls == 6);
+
+    // the Sections.cpp example
+    vector<int> nums(1000);
+    for (int i = 0; i < 1000; ++i)
+        nums[i] = i + 1;
+    long long sum = 0, doubled = 0;
+    parallel_invoke([&] { for (int x : nums) sum += x; }, [&] { for (int x : nums) doubled += 2 * x; });
+    assert(sum == 500'500 && doubled == 2 * 500'500);
+
+    omp_set_num_threads(1);
+    a = 0;
+    assert(parallel_invoke(InvokeStrategy::Sections, [&] { ++a; }, [&] { ++a; }) == InvokeStrategy::Tasks);
+    assert(a == 2);
+
+    omp_set_num_threads(saved);
+}
+
+int delayLength = 0;
+
+void delay(int length)
+{
+    volatile double a = 0.0; // volatile so the loop is not removed
+    for (int i = 0; i < length; ++i)
+        a = a + i;
+}
+
+// sets delayLength so that delay(delayLength) takes about 'seconds'
+void calibrateDelay(double seconds)
+{
+    const int probeLength = 10'000;
+    double best = 1e30;
+    for (int rep = 0; rep < 10; ++rep)
+    {
+        const double start = omp_get_wtime();
+        delay(probeLength);
+        best = min(best, omp_get_wtime() - start);
+    }
+    delayLength = max(1, int(seconds / best * probeLength));
+}
+
+enum class Costs
+{
+    Uniform,
+    Skewed,
+};
+
+// units of work: all 1 delay, or skewed with unit 0 worth half of the total
+vector<int> unitCosts(int n, Costs costs)
+{
+    vector<int> lengths(n, delayLength);
+    if (costs == Costs::Skewed)
+    {
+        lengths.assign(n, max(1, delayLength / 2));
+        lengths[0] = delayLength / 2 * n;
+    }
+    return lengths;
+}
+
+// runSections<N>: N units as N sections
+template <int N>
+void runSections(const vector<int> &lengths);
+
+#define RUN_SECTIONS(n)                                  \
+    template <>                                          \
+    void runSections<n>(const vector<int> &lengths)      \
+    {                                                    \
+        auto unit = [&](int i) { delay(lengths[i]); };   \
+        _Pragma("omp parallel")                          \
+        {                                                \
+            _Pragma("omp sections")                      \
+            {                                            \
+                SECTIONS_##n(0)                          \
+            }                                            \
+        }                                                \
+    }
+
+RUN_SECTIONS(2)
+RUN_SECTIONS(4)
+RUN_SECTIONS(8)
+RUN_SECTIONS(16)
+RUN_SECTIONS(32)
+RUN_SECTIONS(64)
+RUN_SECTIONS(128)
+RUN_SECTIONS(256)
+
+void runTasks(const vector<int> &lengths)
+{
+    const int n = static_cast<int>(lengths.size());
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                #pragma omp task firstprivate(i)
+                delay(lengths[i]);
+            }
+        }
+    }
+}
+
+template <typename Fn>
+double bestSeconds(Fn fn)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < 20; ++rep)
+    {
+        const double start = omp_get_wtime();
+        fn();
+        best = min(best, omp_get_wtime() - start);
+    }
+    return best;
+}
+
+template <int N>
+void benchmarkUnits(double unitSeconds)
+{
+    const int threads = omp_get_max_threads();
+    for (Costs costs : {Costs::Uniform, Costs::Skewed})
+    {
+        const vector<int> lengths = unitCosts(N, costs);
+        double total = 0, longest = 0;
+        for (int length : lengths)
+        {
+            total += length;
+            longest = max(longest, double(length));
+        }
+        // ideal time, in seconds, if scheduling were free. threads beyond the cores only time-slice.
+        const int cores = min(threads, omp_get_num_procs());
+        const double ideal = max(total / cores, longest) / delayLength * unitSeconds;
+
+        const double sections = bestSeconds([&] { runSections<N>(lengths); });
+        const double tasks = bestSeconds([&] { runTasks(lengths); });
+        cout << N << (costs == Costs::Uniform ? "\tuniform\t" : "\tskewed\t") << sections * 1e6 << "\t\t" << tasks * 1e6
+             << "\t\t" << (sections - ideal) / N * 1e6 << "\t\t\t" << (tasks - ideal) / N * 1e6 << '\n';
+    }
+}
+
+/* Sample output (1 core, libgomp, so 4 threads time-slice and small differences are noise):
+4 threads, 20 us per uniform unit
+units	costs	sections us	tasks us	sections us/unit	tasks us/unit
+2	uniform	58.108		50.7		9.054			5.35
+2	skewed	47.436		40.716		8.71982			5.35982
+4	uniform	98.147		91.225		4.53675			2.80625
+4	skewed	89.435		81.254		4.86087			2.81562
+8	uniform	179.583		172.495		2.44787			1.56188
+8	skewed	190.935		159.945		5.11915			1.2454
+16	uniform	336.868		334.72		1.05425			0.92
+16	skewed	327.117		328.394		1.07216			1.15198
+32	uniform	658.409		663.792		0.575281			0.7435
+32	skewed	648.69		650.199		0.586451			0.633607
+64	uniform	1313.45		1324.85		0.522578			0.700797
+64	skewed	1302.9		1278.02		0.516423			0.127689
+128	uniform	2491.35		2620.23		-0.536344			0.470547
+128	skewed	2571.48		2581.23		0.170245			0.246362
+256	uniform	5313.15		5387.85		0.754496			1.0463
+256	skewed	5318.75		5319.02		0.817851			0.81891
+
+With libgomp on this 1-core machine, sections are not cheaper than tasks: both cost about
+a microsecond per unit once the region is amortized, and for a few units tasks were
+faster. Time-slicing adds noise; a multi-core run may separate them. That is why
+parallel_invoke defaults to tasks. Runtimes that turn sections into a static loop may
+make them cheaper, but that also makes them the wrong choice for skewed costs.
+*/
+void benchmark()
+{
+    const double unitSeconds = 20e-6;
+    calibrateDelay(unitSeconds);
+    cout << omp_get_max_threads() << " threads, " << unitSeconds * 1e6 << " us per uniform unit\n";
+    cout << "units\tcosts\tsections us\ttasks us\tsections us/unit\ttasks us/unit\n";
+
+    benchmarkUnits<2>(unitSeconds);
+    benchmarkUnits<4>(unitSeconds);
+    benchmarkUnits<8>(unitSeconds);
+    benchmarkUnits<16>(unitSeconds);
+    benchmarkUnits<32>(unitSeconds);
+    benchmarkUnits<64>(unitSeconds);
+    benchmarkUnits<128>(unitSeconds);
+    benchmarkUnits<256>(unitSeconds);
+}
+
+void test()
+{
+    testChooseInvoke();
+    testParallelInvoke();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
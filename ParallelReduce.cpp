@@ -0,0 +1,332 @@
+/*
+Tests and benchmark for ParallelReduce.h.
+
+Reduction.cpp writes one loop per operator. parallel_reduce<Op, T> picks the loop from
+the operator's constexpr traits instead:
+- Plus, Multiplies, Max, Min have an OpenMP reduction identifier -> reduction clause
+- a commutative, vectorizable op without one (AbsMax below)     -> SIMD lanes
+- anything else, e.g. a non-commutative matrix product           -> ordered tree
+
+Usage: ParallelReduce [elements]
+*/
+
+#include "ParallelReduce.h"
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// largest magnitude. idempotent and vectorizable, but there is no 'reduction' identifier for it.
+// fabs is the transform, so it runs once per element and never on the accumulator.
+struct AbsMax
+{
+    static constexpr bool commutative = true;
+    static constexpr bool idempotent = true;
+    static constexpr bool vectorizable = true;
+    static double transform(double x) { return fabs(x); }
+    double operator()(double a, double b) const { return a < b ? b : a; }
+};
+
+// a clause op with a transform: the clause path applies it too
+struct SquarePlus : Plus<long long>
+{
+    static long long transform(long long x) { return x * x; }
+};
+
+// 2x2 matrices modulo a prime. associative but not commutative.
+struct Mat2
+{
+    static constexpr uint64_t MOD = 1'000'000'007;
+    uint64_t a = 1, b = 0, c = 0, d = 1;
+    bool operator==(const Mat2 &) const = default;
+};
+
+struct MatMul
+{
+    static Mat2 identity() { return Mat2{}; }
+    Mat2 operator()(const Mat2 &x, const Mat2 &y) const
+    {
+        return {(x.a * y.a + x.b * y.c) % Mat2::MOD, (x.a * y.b + x.b * y.d) % Mat2::MOD,
+                (x.c * y.a + x.d * y.c) % Mat2::MOD, (x.c * y.b + x.d * y.d) % Mat2::MOD};
+    }
+};
+
+// no traits at all: parallel_reduce only assumes associativity
+struct Concat
+{
+    string operator()(const string &x, const string &y) const { return x + y; }
+};
+
+struct PlainPlus
+{
+    double operator()(double x, double y) const { return x + y; }
+};
+
+static_assert(chooseStrategy<Plus<int>, int>() == Strategy::Clause);
+static_assert(chooseStrategy<Max<double>, double>() == Strategy::Clause);
+static_assert(chooseStrategy<AbsMax, double>() == Strategy::Lanes);
+static_assert(chooseStrategy<MatMul, Mat2>() == Strategy::Tree);
+static_assert(chooseStrategy<Concat, string>() == Strategy::Tree);
+static_assert(chooseStrategy<PlainPlus, double>() == Strategy::Tree);
+
+// Reduction.cpp sumArray
+void testSum()
+{
+    vector<int> array(100);
+    for (int i = 0; i < 100; ++i)
+        array[i] = i + 1;
+
+    assert((parallel_reduce<Plus<int>, int>(array) == 5050));
+    assert((parallel_reduce<Plus<int>, int, Strategy::Lanes>(array) == 5050));
+    assert((parallel_reduce<Plus<int>, int, Strategy::Tree>(array) == 5050));
+    assert((parallel_reduce<Plus<int>, int>(span<const int>()) == 0));
+}
+
+// Reduction.cpp factorial
+void testFactorial()
+{
+    vector<long long> numbers(15);
+    for (int i = 0; i < 15; ++i)
+        numbers[i] = i + 1;
+
+    assert((parallel_reduce<Multiplies<long long>, long long>(numbers) == 1'307'674'368'000));
+    assert((parallel_reduce<Multiplies<long long>, long long, Strategy::Lanes>(numbers) == 1'307'674'368'000));
+    assert((parallel_reduce<Multiplies<long long>, long long, Strategy::Tree>(numbers) == 1'307'674'368'000));
+}
+
+// Reduction.cpp maxValue
+void testMax()
+{
+    vector<int> array(100);
+    for (int i = 0; i < 100; ++i)
+        array[i] = i + 1;
+
+    constexpr int LARGE_VAL = 1000;
+    array[33] = LARGE_VAL;
+
+    assert((parallel_reduce<Max<int>, int>(array) == LARGE_VAL));
+    assert((parallel_reduce<Max<int>, int, Strategy::Lanes>(array) == LARGE_VAL));
+    assert((parallel_reduce<Max<int>, int, Strategy::Tree>(array) == LARGE_VAL));
+    assert((parallel_reduce<Min<int>, int>(array) == 1));
+}
+
+// sum of squares: every strategy applies the transform exactly once per element
+void testTransform()
+{
+    vector<long long> numbers(100);
+    for (int i = 0; i < 100; ++i)
+        numbers[i] = i + 1;
+
+    static_assert(chooseStrategy<SquarePlus, long long>() == Strategy::Clause);
+    assert((parallel_reduce<SquarePlus, long long>(numbers) == 338'350));
+    assert((parallel_reduce<SquarePlus, long long, Strategy::Lanes>(numbers) == 338'350));
+    assert((parallel_reduce<SquarePlus, long long, Strategy::Tree>(numbers) == 338'350));
+
+    // only negative values: the largest magnitude comes from the smallest element
+    const vector<double> negative = {-1.0, -7.5, -2.0};
+    assert((parallel_reduce<AbsMax, double>(negative) == 7.5));
+    assert((parallel_reduce<AbsMax, double, Strategy::Tree>(negative) == 7.5));
+}
+
+// sizes around the lane width and thread counts that do not divide them
+void testSizes()
+{
+    const int saved = omp_get_max_threads();
+    for (int threads : {1, 2, 3, 7})
+    {
+        omp_set_num_threads(threads);
+        for (size_t n : {1, 2, 15, 16, 17, 63, 64, 65, 1000, 12'345})
+        {
+            vector<int> ints(n);
+            vector<double> doubles(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                ints[i] = int((i * 7919) % 1009);
+                doubles[i] = (i % 2 ? -1.0 : 1.0) * ((i * 104'729) % 10'007);
+            }
+            const long long sum = accumulate(ints.begin(), ints.end(), 0LL);
+            const int largest = *max_element(ints.begin(), ints.end());
+            double absLargest = 0;
+            for (double x : doubles)
+                absLargest = max(absLargest, fabs(x));
+
+            vector<long long> wide(ints.begin(), ints.end());
+            assert((parallel_reduce<Plus<long long>, long long>(wide) == sum));
+            assert((parallel_reduce<Plus<long long>, long long, Strategy::Lanes>(wide) == sum));
+            assert((parallel_reduce<Plus<long long>, long long, Strategy::Tree>(wide) == sum));
+            assert((parallel_reduce<Max<int>, int, Strategy::Lanes>(ints) == largest));
+            assert((parallel_reduce<AbsMax, double>(doubles) == absLargest));
+            assert((parallel_reduce<AbsMax, double, Strategy::Tree>(doubles) == absLargest));
+        }
+    }
+    omp_set_num_threads(saved);
+}
+
+// the tree keeps the element order
+void testNonCommutative()
+{
+    // [[1,1],[1,0]]^n = [[F(n+1), F(n)], [F(n), F(n-1)]]
+    const vector<Mat2> fib(90, Mat2{1, 1, 1, 0});
+    assert((parallel_reduce<MatMul, Mat2>(fib).b == 2'880'067'194'370'816'120ULL % Mat2::MOD));
+    assert((parallel_reduce<MatMul, Mat2>(span<const Mat2>()) == Mat2{}));
+
+    vector<string> letters;
+    string expected;
+    for (int i = 0; i < 1000; ++i)
+    {
+        letters.push_back(string(1, char('a' + i % 26)));
+        expected += letters.back();
+    }
+
+    const int saved = omp_get_max_threads();
+    for (int threads : {1, 2, 3, 5, 8})
+    {
+        omp_set_num_threads(threads);
+        assert((parallel_reduce<Concat, string>(letters) == expected));
+        assert((parallel_reduce<Concat, string>(span<const string>(letters).first(3)) == "abc"));
+    }
+    omp_set_num_threads(saved);
+}
+
+// hand-written loops, as in Reduction.cpp
+double handSum(const vector<double> &v)
+{
+    const long long n = static_cast<long long>(v.size());
+    double result = 0;
+    #pragma omp parallel for reduction(+ : result)
+    for (long long i = 0; i < n; ++i)
+        result += v[i];
+    return result;
+}
+
+int handMax(const vector<int> &v)
+{
+    const long long n = static_cast<long long>(v.size());
+    int result = numeric_limits<int>::min();
+    #pragma omp parallel for reduction(max : result)
+    for (long long i = 0; i < n; ++i)
+    {
+        if (v[i] > result)
+            result = v[i];
+    }
+    return result;
+}
+
+double handAbsMax(const vector<double> &v)
+{
+    const long long n = static_cast<long long>(v.size());
+    double result = 0;
+    #pragma omp parallel for reduction(max : result)
+    for (long long i = 0; i < n; ++i)
+        result = max(result, fabs(v[i]));
+    return result;
+}
+
+template <typename Fn>
+double bestMs(Fn fn)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < 5; ++rep)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+/* Sample output (1 core):
+33554432 elements, 4 threads
+sum of doubles
+  hand-written reduction(+): 45.3613 ms
+  parallel_reduce (clause):  32.8181 ms
+  parallel_reduce (lanes):   37.0036 ms
+  parallel_reduce (tree):    47.1814 ms
+  generic functor (tree):    45.5115 ms
+max of ints
+  hand-written reduction(max): 60.4117 ms
+  parallel_reduce (clause):    37.0513 ms
+  parallel_reduce (lanes):     16.5759 ms
+  parallel_reduce (tree):      57.9689 ms
+largest magnitude of doubles
+  hand-written reduction(max): 79.931 ms
+  parallel_reduce (lanes):     37.6926 ms
+  parallel_reduce (tree):      79.1144 ms
+
+The clause and lanes paths win because of 'simd'. The tree keeps one in-order chain per
+thread, like the hand-written loop, and runs at the same speed (within run-to-run noise).
+*/
+void benchmark(size_t n)
+{
+    vector<double> doubles(n);
+    vector<int> ints(n);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n; ++i)
+    {
+        doubles[i] = ((i * 2'654'435'761ULL) % 1'000'003) / 1e6 - 0.5;
+        ints[i] = int((i * 2'654'435'761ULL) % 1'000'000'007);
+    }
+    cout << n << " elements, " << omp_get_max_threads() << " threads\n";
+
+    volatile double sinkDouble = 0;
+    volatile int sinkInt = 0;
+    auto row = [&](const char *name, auto fn) {
+        const double ms = bestMs([&] {
+            if constexpr (is_same_v<decltype(fn()), int>)
+                sinkInt = fn();
+            else
+                sinkDouble = fn();
+        });
+        cout << name << ms << " ms\n";
+    };
+
+    cout << "sum of doubles\n";
+    row("  hand-written reduction(+): ", [&] { return handSum(doubles); });
+    row("  parallel_reduce (clause):  ", [&] { return parallel_reduce<Plus<double>, double>(doubles); });
+    row("  parallel_reduce (lanes):   ", [&] { return parallel_reduce<Plus<double>, double, Strategy::Lanes>(doubles); });
+    row("  parallel_reduce (tree):    ", [&] { return parallel_reduce<Plus<double>, double, Strategy::Tree>(doubles); });
+    row("  generic functor (tree):    ", [&] { return parallel_reduce<PlainPlus, double>(doubles); });
+
+    cout << "max of ints\n";
+    row("  hand-written reduction(max): ", [&] { return handMax(ints); });
+    row("  parallel_reduce (clause):    ", [&] { return parallel_reduce<Max<int>, int>(ints); });
+    row("  parallel_reduce (lanes):     ", [&] { return parallel_reduce<Max<int>, int, Strategy::Lanes>(ints); });
+    row("  parallel_reduce (tree):      ", [&] { return parallel_reduce<Max<int>, int, Strategy::Tree>(ints); });
+
+    cout << "largest magnitude of doubles\n";
+    row("  hand-written reduction(max): ", [&] { return handAbsMax(doubles); });
+    row("  parallel_reduce (lanes):     ", [&] { return parallel_reduce<AbsMax, double>(doubles); });
+    row("  parallel_reduce (tree):      ", [&] { return parallel_reduce<AbsMax, double, Strategy::Tree>(doubles); });
+}
+
+void test()
+{
+    testSum();
+    testFactorial();
+    testMax();
+    testTransform();
+    testSizes();
+    testNonCommutative();
+}
+
+int main(int argc, char *argv[])
+{
+    test();
+    benchmark(argc > 1 ? stoull(argv[1]) : size_t(1) << 25);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
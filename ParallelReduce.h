@@ -0,0 +1,360 @@
+/*
+parallel_reduce<Op, T>(span): a reduction whose strategy is chosen at compile time
+from the traits of the operator.
+
+An operator is a functor with 'T operator()(T, T) const' and optional static members:
+    identity()    the value x with op(identity, x) == x
+    commutative   op(a, b) == op(b, a), so elements may be combined in any order
+    idempotent    op(a, a) == a, so an element may be combined more than once
+    vectorizable  op is cheap and branch-free enough for '#pragma omp simd'
+    clause        the OpenMP reduction identifier that computes op (+, *, max, min)
+    transform(x)  applied once to every element before it is combined, so op and
+                  identity only see transformed values (e.g. fabs for a largest magnitude)
+A missing trait is false, so a plain functor is treated as associative only.
+
+Strategies, in order of preference:
+    Clause  'parallel for simd reduction(op : result)': the compiler's own reduction
+    Lanes   each thread keeps LANES accumulators updated under '#pragma omp simd'.
+            needs commutative + vectorizable, and an identity or idempotence
+            (idempotent ops seed the lanes with the data and overlap the tail)
+    Tree    each thread folds one contiguous chunk in order, then the partial results
+            are combined pairwise in log2(threads) rounds. keeps the element order,
+            so it is correct for any associative op (matrix product, concatenation).
+
+Example:
+    vector<int> v = {...};
+    int sum = parallel_reduce<Plus<int>, int>(v);
+    Mat2 product = parallel_reduce<MatMul, Mat2>(matrices);
+*/
+
+#pragma once
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+enum class Clause
+{
+    None,
+    Plus,
+    Multiplies,
+    Max,
+    Min,
+};
+
+enum class Strategy
+{
+    Clause,
+    Lanes,
+    Tree,
+};
+
+template <typename T>
+struct Plus
+{
+    static constexpr T identity() { return T(0); }
+    static constexpr bool commutative = true;
+    static constexpr bool vectorizable = true;
+    static constexpr Clause clause = Clause::Plus;
+    T operator()(T a, T b) const { return a + b; }
+};
+
+template <typename T>
+struct Multiplies
+{
+    static constexpr T identity() { return T(1); }
+    static constexpr bool commutative = true;
+    static constexpr bool vectorizable = true;
+    static constexpr Clause clause = Clause::Multiplies;
+    T operator()(T a, T b) const { return a * b; }
+};
+
+template <typename T>
+struct Max
+{
+    static constexpr T identity() { return std::numeric_limits<T>::lowest(); }
+    static constexpr bool commutative = true;
+    static constexpr bool idempotent = true;
+    static constexpr bool vectorizable = true;
+    static constexpr Clause clause = Clause::Max;
+    T operator()(T a, T b) const { return a < b ? b : a; }
+};
+
+template <typename T>
+struct Min
+{
+    static constexpr T identity() { return std::numeric_limits<T>::max(); }
+    static constexpr bool commutative = true;
+    static constexpr bool idempotent = true;
+    static constexpr bool vectorizable = true;
+    static constexpr Clause clause = Clause::Min;
+    T operator()(T a, T b) const { return b < a ? b : a; }
+};
+
+template <typename Op>
+struct ReduceTraits
+{
+    static constexpr bool hasIdentity = requires { Op::identity(); };
+    static constexpr bool hasTransform = requires { &Op::transform; };
+
+    static constexpr bool commutative = [] {
+        if constexpr (requires { Op::commutative; })
+            return bool(Op::commutative);
+        return false;
+    }();
+
+    static constexpr bool idempotent = [] {
+        if constexpr (requires { Op::idempotent; })
+            return bool(Op::idempotent);
+        return false;
+    }();
+
+    static constexpr bool vectorizable = [] {
+        if constexpr (requires { Op::vectorizable; })
+            return bool(Op::vectorizable);
+        return false;
+    }();
+
+    static constexpr Clause clause = [] {
+        if constexpr (requires { Op::clause; })
+            return Clause(Op::clause);
+        return Clause::None;
+    }();
+};
+
+template <typename Op, typename T>
+constexpr bool canUseClause()
+{
+    // reduction clauses only exist for arithmetic types
+    return ReduceTraits<Op>::clause != Clause::None && ReduceTraits<Op>::hasIdentity && std::is_arithmetic_v<T>;
+}
+
+template <typename Op, typename T>
+constexpr bool canUseLanes()
+{
+    using Traits = ReduceTraits<Op>;
+    return Traits::commutative && Traits::vectorizable && (Traits::hasIdentity || Traits::idempotent) &&
+           std::is_trivially_copyable_v<T>;
+}
+
+template <typename Op, typename T>
+constexpr Strategy chooseStrategy()
+{
+    if constexpr (canUseClause<Op, T>())
+        return Strategy::Clause;
+    else if constexpr (canUseLanes<Op, T>())
+        return Strategy::Lanes;
+    else
+        return Strategy::Tree;
+}
+
+namespace detail
+{
+
+// an element as the op sees it: Op::transform(x) if there is one, else x itself (no copy)
+template <typename Op, typename T>
+decltype(auto) load(const T &x)
+{
+    if constexpr (ReduceTraits<Op>::hasTransform)
+        return T(Op::transform(x));
+    else
+        return (x);
+}
+
+template <typename Op, typename T>
+T clauseReduce(std::span<const T> data)
+{
+    const T *p = data.data();
+    const long long n = static_cast<long long>(data.size());
+    T result = Op::identity();
+
+    if constexpr (ReduceTraits<Op>::clause == Clause::Plus)
+    {
+        #pragma omp parallel for simd schedule(static) reduction(+ : result)
+        for (long long i = 0; i < n; ++i)
+            result += load<Op>(p[i]);
+    }
+    else if constexpr (ReduceTraits<Op>::clause == Clause::Multiplies)
+    {
+        #pragma omp parallel for simd schedule(static) reduction(* : result)
+        for (long long i = 0; i < n; ++i)
+            result *= load<Op>(p[i]);
+    }
+    else if constexpr (ReduceTraits<Op>::clause == Clause::Max)
+    {
+        #pragma omp parallel for simd schedule(static) reduction(max : result)
+        for (long long i = 0; i < n; ++i)
+        {
+            const T x = load<Op>(p[i]);
+            result = result < x ? x : result;
+        }
+    }
+    else if constexpr (ReduceTraits<Op>::clause == Clause::Min)
+    {
+        #pragma omp parallel for simd schedule(static) reduction(min : result)
+        for (long long i = 0; i < n; ++i)
+        {
+            const T x = load<Op>(p[i]);
+            result = x < result ? x : result;
+        }
+    }
+    return result;
+}
+
+template <typename Op, typename T>
+T lanesReduce(std::span<const T> data)
+{
+    // two cache lines of accumulators: enough independent chains to hide the op's latency
+    constexpr size_t LANES = std::max<size_t>(128 / sizeof(T), 1);
+    using Traits = ReduceTraits<Op>;
+
+    const T *p = data.data();
+    const size_t n = data.size();
+    if (n == 0)
+    {
+        if constexpr (Traits::hasIdentity)
+            return Op::identity();
+        assert(!"parallel_reduce of an empty span needs an identity");
+        return T{};
+    }
+
+    // no thread gets less than a few vectors of work
+    const int threads = static_cast<int>(std::clamp<size_t>(n / (4 * LANES), 1, omp_get_max_threads()));
+    std::vector<std::optional<T>> partial(threads);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        const Op op;
+        const int team = omp_get_num_threads();
+        const int thread = omp_get_thread_num();
+        const size_t begin = n * thread / team;
+        const size_t end = n * (thread + 1) / team;
+
+        T result;
+        if (end - begin < LANES)
+        {
+            // too short for the lanes: fold in order
+            result = load<Op>(p[begin]);
+            for (size_t i = begin + 1; i < end; ++i)
+                result = op(result, load<Op>(p[i]));
+        }
+        else
+        {
+            alignas(64) T lanes[LANES];
+            size_t i = begin;
+            if constexpr (Traits::hasIdentity)
+            {
+                std::fill(lanes, lanes + LANES, Op::identity());
+            }
+            else
+            {
+                for (size_t lane = 0; lane < LANES; ++lane)
+                    lanes[lane] = load<Op>(p[begin + lane]);
+                i += LANES;
+            }
+
+            for (; i + LANES <= end; i += LANES)
+            {
+                #pragma omp simd
+                for (size_t lane = 0; lane < LANES; ++lane)
+                    lanes[lane] = op(lanes[lane], load<Op>(p[i + lane]));
+            }
+
+            if constexpr (Traits::idempotent)
+            {
+                // redo the last full vector: elements seen twice do not change the result
+                if (i < end)
+                {
+                    #pragma omp simd
+                    for (size_t lane = 0; lane < LANES; ++lane)
+                        lanes[lane] = op(lanes[lane], load<Op>(p[end - LANES + lane]));
+                }
+            }
+            else
+            {
+                for (size_t lane = 0; i < end; ++i, ++lane)
+                    lanes[lane] = op(lanes[lane], load<Op>(p[i]));
+            }
+
+            result = lanes[0];
+            for (size_t lane = 1; lane < LANES; ++lane)
+                result = op(result, lanes[lane]);
+        }
+        partial[thread] = result;
+    }
+
+    // threads the runtime did not start have no partial result
+    const Op op;
+    T result = *partial[0];
+    for (int t = 1; t < threads && partial[t]; ++t)
+        result = op(result, *partial[t]);
+    return result;
+}
+
+template <typename Op, typename T>
+T treeReduce(std::span<const T> data)
+{
+    const size_t n = data.size();
+    if (n == 0)
+    {
+        if constexpr (ReduceTraits<Op>::hasIdentity)
+            return Op::identity();
+        assert(!"parallel_reduce of an empty span needs an identity");
+        return T{};
+    }
+
+    // every thread needs at least one element, there is no identity to start from
+    const int threads = static_cast<int>(std::min<size_t>(n, omp_get_max_threads()));
+    std::vector<std::optional<T>> partial(threads);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        const Op op;
+        const int team = omp_get_num_threads();
+        const int thread = omp_get_thread_num();
+        const size_t begin = n * thread / team;
+        const size_t end = n * (thread + 1) / team;
+
+        T result = load<Op>(data[begin]);
+        for (size_t i = begin + 1; i < end; ++i)
+            result = op(result, load<Op>(data[i]));
+        partial[thread] = std::move(result);
+
+        // round r: thread t (a multiple of 2^(r+1)) absorbs its right neighbour t + 2^r
+        for (int step = 1; step < team; step *= 2)
+        {
+            #pragma omp barrier
+            if (thread % (2 * step) == 0 && thread + step < team)
+                partial[thread] = op(*partial[thread], *partial[thread + step]);
+        }
+    }
+    return *partial[0];
+}
+
+} // namespace detail
+
+// reduces 'data' with Op. an empty span gives Op::identity() (and needs one).
+template <typename Op, typename T, Strategy S = chooseStrategy<Op, T>()>
+T parallel_reduce(std::span<const T> data)
+{
+    if constexpr (S == Strategy::Clause)
+    {
+        static_assert(canUseClause<Op, T>(), "Op has no OpenMP reduction clause for T");
+        return detail::clauseReduce<Op, T>(data);
+    }
+    else if constexpr (S == Strategy::Lanes)
+    {
+        static_assert(canUseLanes<Op, T>(), "Lanes needs a commutative, vectorizable Op with an identity or idempotence");
+        return detail::lanesReduce<Op, T>(data);
+    }
+    else
+    {
+        return detail::treeReduce<Op, T>(data);
+    }
+}
@@ -0,0 +1,334 @@
+/*
+Floating-point addition is not associative: (a + b) + c can differ from a + (b + c).
+'reduction(+ : sum)' gives each thread a private partial sum and combines them in
+an unspecified order, so the result of a double reduction can change with the
+number of threads, the schedule and even between runs.
+
+Reproducible alternatives, from cheapest to most accurate:
+1. tree:     the array is cut into fixed-size blocks (independent of the team size).
+             Each block is summed in a fixed order and the block sums are added in a
+             fixed pairwise tree. Threads only decide who computes which block.
+2. neumaier: same fixed shape, with Neumaier's compensated summation in each block
+             and in the tree. Error is about one rounding instead of O(n) roundings.
+             https://en.wikipedia.org/wiki/Kahan_summation_algorithm
+3. binned:   every value is split into a few slices aligned to fixed exponent
+             boundaries (bins) that depend only on max|x| and n. The slices of one
+             bin are all multiples of the same power of two and their sum cannot
+             overflow the mantissa, so every partial sum is exact and the order
+             does not matter. A plain 'reduction(+)' over the slices is then
+             reproducible for any thread count and schedule (the ReproBLAS idea).
+             https://bebop.cs.berkeley.edu/reproblas/
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// elements per block of the tree reductions. fixed so the result does not depend on the team.
+constexpr size_t BLOCK = 1024;
+
+// number of bins for the binned sum. each bin adds about 53 - log2(n) bits of accuracy.
+constexpr int BINS = 3;
+
+double plainSum(const vector<double> &x, int threads)
+{
+    double sum = 0.0;
+    const long long n = static_cast<long long>(x.size());
+
+    #pragma omp parallel for reduction(+ : sum) num_threads(threads)
+    for (long long i = 0; i < n; ++i)
+        sum += x[i];
+
+    return sum;
+}
+
+// sums x[begin, end) with 8 independent lanes, which vectorizes but keeps a fixed order
+double blockSum(const double *x, size_t begin, size_t end)
+{
+    double lanes[8] = {};
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        #pragma omp simd
+        for (int l = 0; l < 8; ++l)
+            lanes[l] += x[i + l];
+    }
+    for (int l = 0; i < end; ++i, ++l)
+        lanes[l] += x[i];
+
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+// adds partial[i + stride] into partial[i] level by level. the tree shape only depends on partial.size().
+template <typename T, typename Add>
+T pairwiseTree(vector<T> &partial, int threads, Add add)
+{
+    const long long count = static_cast<long long>(partial.size());
+    for (long long stride = 1; stride < count; stride *= 2)
+    {
+        #pragma omp parallel for num_threads(threads)
+        for (long long i = 0; i < count - stride; i += 2 * stride)
+            partial[i] = add(partial[i], partial[i + stride]);
+    }
+    return count > 0 ? partial[0] : T{};
+}
+
+double treeSum(const vector<double> &x, int threads)
+{
+    const long long blocks = static_cast<long long>((x.size() + BLOCK - 1) / BLOCK);
+    vector<double> partial(blocks);
+
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (long long b = 0; b < blocks; ++b)
+        partial[b] = blockSum(x.data(), b * BLOCK, min(x.size(), size_t(b + 1) * BLOCK));
+
+    return pairwiseTree(partial, threads, [](double a, double b) { return a + b; });
+}
+
+// running sum plus the low-order bits lost by each addition
+struct Neumaier
+{
+    double sum = 0.0;
+    double compensation = 0.0;
+
+    void add(double x)
+    {
+        const double t = sum + x;
+        // recover the part of the smaller operand that did not fit in t
+        if (fabs(sum) >= fabs(x))
+            compensation += (sum - t) + x;
+        else
+            compensation += (x - t) + sum;
+        sum = t;
+    }
+
+    void add(const Neumaier &other)
+    {
+        add(other.sum);
+        compensation += other.compensation;
+    }
+
+    double result() const { return sum + compensation; }
+};
+
+double neumaierSum(const vector<double> &x, int threads)
+{
+    const long long blocks = static_cast<long long>((x.size() + BLOCK - 1) / BLOCK);
+    vector<Neumaier> partial(blocks);
+
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (long long b = 0; b < blocks; ++b)
+    {
+        const size_t end = min(x.size(), size_t(b + 1) * BLOCK);
+        for (size_t i = b * BLOCK; i < end; ++i)
+            partial[b].add(x[i]);
+    }
+
+    return pairwiseTree(partial, threads, [](Neumaier a, const Neumaier &b) {
+               a.add(b);
+               return a;
+           }).result();
+}
+
+/*
+Bin k uses the boundary M = 1.5 * 2^e, where 2^e >= 2 * n * (largest value left at bin k).
+fl(fl(M + x) - M) rounds x to a multiple of ulp(M) and the rest, x - q, is exact.
+All n slices are multiples of ulp(M) and their total is below 2^(e+1) = 2^53 * ulp(M),
+so every partial sum of the slices is exact in any order.
+*/
+double binnedSum(const vector<double> &x, int threads)
+{
+    const long long n = static_cast<long long>(x.size());
+
+    double maxAbs = 0.0;
+    #pragma omp parallel for reduction(max : maxAbs) num_threads(threads)
+    for (long long i = 0; i < n; ++i)
+        maxAbs = max(maxAbs, fabs(x[i]));
+
+    if (maxAbs == 0.0 || n == 0)
+        return 0.0;
+
+    // boundaries depend only on maxAbs and n, never on the order of the data
+    double boundary[BINS];
+    double bound = maxAbs;
+    for (int k = 0; k < BINS; ++k)
+    {
+        int e;
+        frexp(2.0 * double(n) * bound, &e); // 2^e > 2 * n * bound
+        boundary[k] = ldexp(1.5, e);
+        bound = ldexp(1.0, e - 53); // residuals are at most ulp(boundary) / 2
+    }
+
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0;
+    static_assert(BINS == 3, "one reduction variable per bin");
+
+    #pragma omp parallel for reduction(+ : s0, s1, s2) num_threads(threads)
+    for (long long i = 0; i < n; ++i)
+    {
+        double r = x[i];
+
+        double q = (boundary[0] + r) - boundary[0];
+        s0 += q;
+        r -= q;
+
+        q = (boundary[1] + r) - boundary[1];
+        s1 += q;
+        r -= q;
+
+        q = (boundary[2] + r) - boundary[2];
+        s2 += q;
+    }
+
+    // each bin sum is exact; add them from the smallest in a fixed order
+    return s0 + (s1 + s2);
+}
+
+bool sameBits(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+/*
+Values with a wide range of magnitudes and both signs. Every value appears with its
+negation, plus the integers 1..count, so the exact sum is count * (count + 1) / 2.
+*/
+vector<double> cancellingData(size_t pairs, size_t count, unsigned seed)
+{
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> mantissa(1.0, 2.0);
+    uniform_int_distribution<int> exponent(-30, 30);
+
+    vector<double> x;
+    for (size_t i = 0; i < pairs; ++i)
+    {
+        double v = ldexp(mantissa(rng), exponent(rng));
+        x.push_back(v);
+        x.push_back(-v);
+    }
+    for (size_t i = 1; i <= count; ++i)
+        x.push_back(double(i));
+
+    shuffle(x.begin(), x.end(), rng);
+    return x;
+}
+
+void testNeumaier()
+{
+    // plain summation loses the 1.0 entirely, compensated summation keeps it
+    Neumaier acc;
+    for (double v : {1.0, 1e100, 1.0, -1e100})
+        acc.add(v);
+    assert(acc.result() == 2.0);
+}
+
+void testReproducible()
+{
+    const vector<double> x = cancellingData(50'000, 1000, 7);
+    const double exact = 1000.0 * 1001.0 / 2.0;
+
+    using Sum = double (*)(const vector<double> &, int);
+    const Sum reproducible[] = {treeSum, neumaierSum, binnedSum};
+
+    // bitwise-identical results from 1 thread up to (and past) the core count
+    const int maxThreads = max(4, omp_get_max_threads());
+    for (Sum sum : reproducible)
+    {
+        const double reference = sum(x, 1);
+        for (int threads = 2; threads <= maxThreads; ++threads)
+            assert(sameBits(sum(x, threads), reference));
+    }
+
+    // compensated and binned sums are accurate despite the cancellation
+    assert(fabs(neumaierSum(x, 1) - exact) <= 1e-9 * exact);
+    assert(fabs(binnedSum(x, 1) - exact) <= 1e-9 * exact);
+
+    // binned sums do not even depend on the order of the data
+    vector<double> reversed(x.rbegin(), x.rend());
+    assert(sameBits(binnedSum(reversed, 3), binnedSum(x, 1)));
+
+    // small and degenerate inputs
+    assert(treeSum({}, 2) == 0.0 && neumaierSum({}, 2) == 0.0 && binnedSum({}, 2) == 0.0);
+    assert(binnedSum({0.0, 0.0}, 2) == 0.0);
+    assert(binnedSum({3.0}, 2) == 3.0);
+    assert(treeSum({1.0, 2.0, 3.0}, 2) == 6.0);
+}
+
+template <typename Fn>
+double bestSeconds(Fn fn)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < 5; ++rep)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+/* Sample output:
+n = 16778216, threads 1..4
+method     ms        vs plain  error        identical for 1..N threads
+plain      29.1946   1         0.0134629    no
+tree       25.3257   0.867478  0.000465393  yes
+neumaier   72.364    2.47868   0            yes
+binned     133.276   4.56511   0            yes
+*/
+void benchmark()
+{
+    const size_t pairs = size_t(1) << 23;
+    const vector<double> x = cancellingData(pairs, 1000, 11);
+    const double exact = 1000.0 * 1001.0 / 2.0;
+    const int maxThreads = max(4, omp_get_max_threads());
+
+    cout << "n = " << x.size() << ", threads 1.." << maxThreads << '\n';
+    cout << "method     ms        vs plain  error       identical for 1..N threads\n";
+
+    using Sum = double (*)(const vector<double> &, int);
+    const pair<const char *, Sum> methods[] = {
+        {"plain", plainSum}, {"tree", treeSum}, {"neumaier", neumaierSum}, {"binned", binnedSum}};
+
+    double plainSeconds = 0.0;
+    for (auto [name, sum] : methods)
+    {
+        const double seconds = bestSeconds([&] { sum(x, omp_get_max_threads()); });
+        if (plainSeconds == 0.0)
+            plainSeconds = seconds;
+
+        const double reference = sum(x, 1);
+        bool identical = true;
+        for (int threads = 2; threads <= maxThreads; ++threads)
+            identical = identical && sameBits(sum(x, threads), reference);
+
+        cout << name << "\t   " << seconds * 1e3 << "\t" << seconds / plainSeconds << "\t  "
+             << fabs(reference - exact) << "\t" << (identical ? "yes" : "no") << '\n';
+    }
+}
+
+void test()
+{
+    testNeumaier();
+    testReproducible();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
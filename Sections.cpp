@@ -9,10 +9,9 @@ https://www.openmp.org/spec-html/5.1/openmpsu42.html
 
 Task vs Section:
 - Tasks are more suited for irregular parallelism such as through recursion.
-- Tasks have higher overhead to create and schedule
 - Sections are more suited for rigid parallelism where the # of parallel units is
     known during compilation.
-- Sections have lower overhead.
+- For the overhead of each, see ParallelInvoke.cpp.
 
 Syntax:
 #pragma omp sections [clause[ [,] clause] ... ]
@@ -0,0 +1,941 @@
+/*
+Lock-free skip list: an ordered map that threads can insert into, search and scan
+at the same time. Unordered containers plus 'critical' serialize every update and
+can't answer range queries; a skip list keeps keys sorted and only contends where
+two threads change the same links.
+
+Keir Fraser, Practical lock-freedom (section 4.3.3 and 5.2.3):
+https://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf
+Herlihy & Shavit, The Art of Multiprocessor Programming, chapter 14.4
+
+Each node is linked into levels 0..height-1. Level 0 holds every key; each level
+above holds about half the nodes of the one below, so a search skips ahead in
+O(log n) steps. A link is a node address whose lowest bit is the "removed" mark:
+- insert: CAS the new node into level 0 (this is when the key appears), then into
+  the upper levels one at a time
+- erase: mark the node's links from the top down. Marking level 0 removes the key.
+  A marked link can't be changed, so nothing can be inserted after a removed node.
+- searches that walk over a marked node unlink it with a CAS on its predecessor
+
+Memory reclamation: an unlinked node may still be read by a thread that loaded a
+pointer to it earlier, so it can't be deleted right away. Epoch-based reclamation
+waits until every thread has been seen outside of an operation since the unlink.
+
+The benchmark compares std::map under one critical section and under 64 striped
+omp_lock_t locks.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// compare-and-swap on 'x'. returns true if x was 'expected' and is now 'desired'.
+inline bool compareAndSwap(uintptr_t &x, uintptr_t expected, uintptr_t desired)
+{
+    uintptr_t old;
+    #pragma omp atomic compare capture seq_cst
+    {
+        old = x;
+        if (x == expected) { x = desired; }
+    }
+    return old == expected;
+}
+
+inline uintptr_t loadLink(uintptr_t &link)
+{
+    uintptr_t value;
+    #pragma omp atomic read acquire
+    value = link;
+    return value;
+}
+
+// the lowest bit of a link marks the node that owns the link as removed
+inline bool isMarked(uintptr_t link) { return link & 1; }
+inline uintptr_t marked(uintptr_t link) { return link | 1; }
+inline uintptr_t unmarked(uintptr_t link) { return link & ~uintptr_t(1); }
+
+// every thread that uses an EpochManager gets a process-wide slot on first use
+constexpr size_t MAX_THREADS = 256;
+inline size_t registeredThreads = 0;
+
+inline size_t threadSlot()
+{
+    thread_local size_t slot = MAX_THREADS;
+    if (slot == MAX_THREADS)
+    {
+        #pragma omp atomic capture
+        slot = registeredThreads++;
+        assert(slot < MAX_THREADS);
+    }
+    return slot;
+}
+
+/*
+Epoch-based reclamation:
+- a global epoch counter that only goes up
+- a thread inside an operation announces the epoch it saw when it entered
+- a removed node goes on the remover's limbo list, tagged with the current epoch
+- the epoch advances when every thread inside an operation has announced it
+- a node retired in epoch e is freed once the global epoch reaches e + 2. Any
+  thread that could have loaded a pointer to it entered before the node was
+  unlinked, and the epoch can't pass e + 1 until that thread has left.
+A thread stalled inside an operation blocks reclamation (but not progress).
+*/
+template <typename Node>
+class EpochManager
+{
+public:
+    using Deleter = void (*)(Node *);
+
+    // how many nodes a thread retires between attempts to free its limbo list
+    static constexpr size_t RECLAIM_BATCH = 64;
+
+    explicit EpochManager(Deleter deleter)
+        : slots_(MAX_THREADS), deleter_(deleter)
+    {
+    }
+
+    ~EpochManager()
+    {
+        for (Slot &slot : slots_)
+        {
+            for (auto &[epoch, node] : slot.limbo)
+                deleter_(node);
+        }
+    }
+
+    EpochManager(const EpochManager &) = delete;
+    EpochManager &operator=(const EpochManager &) = delete;
+
+    // nested enter/exit pairs are allowed; only the outermost one announces
+    void enter()
+    {
+        Slot &slot = slots_[threadSlot()];
+        if (slot.depth++ > 0)
+            return;
+
+        size_t epoch;
+        #pragma omp atomic read seq_cst
+        epoch = epoch_;
+        #pragma omp atomic write seq_cst
+        slot.announced = (epoch << 1) | 1;
+        // no link may be read before the announcement is visible to reclaimers
+        #pragma omp flush
+    }
+
+    void exit()
+    {
+        Slot &slot = slots_[threadSlot()];
+        assert(slot.depth > 0);
+        if (--slot.depth > 0)
+            return;
+
+        #pragma omp atomic write release
+        slot.announced = 0;
+    }
+
+    // enter() for the lifetime of one operation
+    class Guard
+    {
+    public:
+        explicit Guard(EpochManager &epochs) : epochs_(epochs) { epochs_.enter(); }
+        ~Guard() { epochs_.exit(); }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        EpochManager &epochs_;
+    };
+
+    // 'node' must already be unlinked, so threads that enter from now on can't reach it
+    void retire(Node *node)
+    {
+        Slot &slot = slots_[threadSlot()];
+        size_t epoch;
+        #pragma omp atomic read seq_cst
+        epoch = epoch_;
+        slot.limbo.push_back({epoch, node});
+
+        if (slot.limbo.size() % RECLAIM_BATCH == 0)
+            reclaim();
+    }
+
+    // advances the epoch if possible, then frees this thread's nodes that are two epochs old
+    void reclaim()
+    {
+        tryAdvance();
+
+        size_t epoch;
+        #pragma omp atomic read seq_cst
+        epoch = epoch_;
+
+        auto &limbo = slots_[threadSlot()].limbo;
+        auto kept = partition(limbo.begin(), limbo.end(),
+                              [&](const pair<size_t, Node *> &retired) { return retired.first + 2 > epoch; });
+        for (auto it = kept; it != limbo.end(); ++it)
+            deleter_(it->second);
+        limbo.erase(kept, limbo.end());
+    }
+
+    // retired nodes not freed yet, over all threads. only meaningful when no thread is retiring.
+    size_t pending() const
+    {
+        size_t total = 0;
+        for (const Slot &slot : slots_)
+            total += slot.limbo.size();
+        return total;
+    }
+
+private:
+    struct alignas(64) Slot
+    {
+        size_t announced = 0; // (epoch << 1) | 1 inside an operation, 0 outside
+        int depth = 0;        // only written by the owning thread
+        vector<pair<size_t, Node *>> limbo;
+    };
+
+    void tryAdvance()
+    {
+        size_t epoch;
+        #pragma omp atomic read seq_cst
+        epoch = epoch_;
+
+        size_t threads;
+        #pragma omp atomic read
+        threads = registeredThreads;
+
+        for (size_t i = 0; i < min(threads, MAX_THREADS); ++i)
+        {
+            size_t announced;
+            #pragma omp atomic read seq_cst
+            announced = slots_[i].announced;
+            if ((announced & 1) && (announced >> 1) != epoch)
+                return; // a thread is still inside an operation from an older epoch
+        }
+
+        // another thread may have advanced it already
+        compareAndSwap(epoch_, epoch, epoch + 1);
+    }
+
+    vector<Slot> slots_;
+    alignas(64) size_t epoch_ = 0;
+    const Deleter deleter_;
+};
+
+/*
+Ordered map with lock-free insert, erase, find and range scans.
+Keys need operator<; values are written once by insert and never change.
+*/
+template <typename K, typename V>
+class SkipList
+{
+public:
+    static constexpr int MAX_LEVEL = 24;
+
+    SkipList()
+        : head_(createNode(K{}, V{}, MAX_LEVEL)), epochs_(destroyNode)
+    {
+    }
+
+    ~SkipList()
+    {
+        // no other thread is inside an operation, so level 0 holds exactly the live nodes
+        Node *node = toNode(head_->next()[0]);
+        while (node)
+        {
+            Node *next = toNode(node->next()[0]);
+            destroyNode(node);
+            node = next;
+        }
+        destroyNode(head_);
+    }
+
+    SkipList(const SkipList &) = delete;
+    SkipList &operator=(const SkipList &) = delete;
+
+    // returns false if the key is already present
+    bool insert(const K &key, const V &value)
+    {
+        Guard guard(epochs_);
+        Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+        Node *node = nullptr;
+
+        for (;;)
+        {
+            if (search(key, preds, succs))
+            {
+                if (node)
+                    destroyNode(node); // never published
+                return false;
+            }
+
+            if (!node)
+                node = createNode(key, value, randomHeight());
+            for (int level = 0; level < node->height; ++level)
+                node->next()[level] = link(succs[level]);
+
+            // the key appears when the node is linked into level 0
+            if (compareAndSwap(preds[0]->next()[0], link(succs[0]), link(node)))
+                break;
+        }
+
+        // link the upper levels, until done or a concurrent erase has marked the node
+        bool removed = false;
+        for (int level = 1; level < node->height && !removed; ++level)
+        {
+            for (;;)
+            {
+                uintptr_t next = loadLink(node->next()[level]);
+                if (isMarked(next))
+                {
+                    removed = true;
+                    break;
+                }
+
+                // the successor may have changed since the last search
+                if (next != link(succs[level]) &&
+                    !compareAndSwap(node->next()[level], next, link(succs[level])))
+                    continue;
+
+                if (compareAndSwap(preds[level]->next()[level], link(succs[level]), link(node)))
+                    break;
+
+                search(key, preds, succs);
+                if (succs[0] != node)
+                {
+                    removed = true;
+                    break;
+                }
+            }
+        }
+
+        release(node);
+        return true;
+    }
+
+    // returns false if the key is not present (or another thread erased it first)
+    bool erase(const K &key)
+    {
+        Guard guard(epochs_);
+        Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+        if (!search(key, preds, succs))
+            return false;
+
+        // mark from the top down so no new node can be linked after this one
+        Node *node = succs[0];
+        for (int level = node->height - 1; level >= 1; --level)
+        {
+            uintptr_t next = loadLink(node->next()[level]);
+            while (!isMarked(next))
+            {
+                compareAndSwap(node->next()[level], next, marked(next));
+                next = loadLink(node->next()[level]);
+            }
+        }
+
+        // whoever marks level 0 has removed the key
+        for (;;)
+        {
+            uintptr_t next = loadLink(node->next()[0]);
+            if (isMarked(next))
+                return false;
+            if (compareAndSwap(node->next()[0], next, marked(next)))
+                break;
+        }
+
+        release(node);
+        return true;
+    }
+
+    bool find(const K &key, V &value)
+    {
+        Guard guard(epochs_);
+        Node *node = lowerBound(key);
+        if (!node || key < node->key)
+            return false;
+
+        value = node->value;
+        return true;
+    }
+
+    bool contains(const K &key)
+    {
+        V value;
+        return find(key, value);
+    }
+
+    /*
+    Calls visit(key, value) for the keys in [lo, hi), in increasing order.
+    Not a snapshot: every key present for the whole scan is visited, keys inserted
+    or erased during the scan may or may not be.
+    */
+    template <typename F>
+    void forRange(const K &lo, const K &hi, F visit)
+    {
+        Guard guard(epochs_);
+        Node *node = lowerBound(lo);
+        while (node && node->key < hi)
+        {
+            uintptr_t next = loadLink(node->next()[0]);
+            if (!isMarked(next))
+                visit(node->key, node->value);
+            node = toNode(next);
+        }
+    }
+
+    // frees removed nodes once no thread can still be reading them
+    void reclaim() { epochs_.reclaim(); }
+    size_t pendingReclaim() const { return epochs_.pending(); }
+
+private:
+    // the links follow the node in the same allocation, one per level
+    struct alignas(uintptr_t) Node
+    {
+        K key;
+        V value;
+        int height;
+        int owners; // the inserter and the eraser. the last one to finish retires the node.
+
+        uintptr_t *next() { return reinterpret_cast<uintptr_t *>(this + 1); }
+    };
+
+    using Guard = typename EpochManager<Node>::Guard;
+
+    static Node *createNode(const K &key, const V &value, int height)
+    {
+        void *memory = ::operator new(sizeof(Node) + height * sizeof(uintptr_t));
+        Node *node = new (memory) Node{key, value, height, 2};
+        fill(node->next(), node->next() + height, uintptr_t(0));
+        return node;
+    }
+
+    static void destroyNode(Node *node)
+    {
+        node->~Node();
+        ::operator delete(node);
+    }
+
+    static Node *toNode(uintptr_t link) { return reinterpret_cast<Node *>(unmarked(link)); }
+    static uintptr_t link(Node *node) { return reinterpret_cast<uintptr_t>(node); }
+
+    // each level is kept with probability 1/2
+    static int randomHeight()
+    {
+        thread_local uint64_t state = hash<thread::id>{}(this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return min(MAX_LEVEL, 1 + countr_zero(state));
+    }
+
+    /*
+    Fills preds/succs with the nodes on either side of 'key' at every level, unlinking
+    marked nodes on the way. Restarts from the head if an unlink fails, which means
+    the predecessor changed or was marked itself.
+    Returns true if succs[0] holds 'key'.
+    */
+    bool search(const K &key, Node **preds, Node **succs)
+    {
+        for (;;)
+        {
+            bool restart = false;
+            Node *pred = head_;
+            for (int level = MAX_LEVEL - 1; level >= 0 && !restart; --level)
+            {
+                Node *curr = toNode(loadLink(pred->next()[level]));
+                while (curr)
+                {
+                    uintptr_t succ = loadLink(curr->next()[level]);
+                    if (isMarked(succ))
+                    {
+                        if (!compareAndSwap(pred->next()[level], link(curr), unmarked(succ)))
+                        {
+                            restart = true;
+                            break;
+                        }
+                        curr = toNode(succ);
+                        continue;
+                    }
+
+                    if (!(curr->key < key))
+                        break;
+                    pred = curr;
+                    curr = toNode(succ);
+                }
+
+                preds[level] = pred;
+                succs[level] = curr;
+            }
+
+            if (!restart)
+                return succs[0] && !(key < succs[0]->key);
+        }
+    }
+
+    // first unmarked node with a key >= 'key'. steps over marked nodes without writing anything.
+    Node *lowerBound(const K &key)
+    {
+        Node *pred = head_;
+        Node *curr = nullptr;
+        for (int level = MAX_LEVEL - 1; level >= 0; --level)
+        {
+            curr = toNode(loadLink(pred->next()[level]));
+            while (curr)
+            {
+                uintptr_t succ = loadLink(curr->next()[level]);
+                if (isMarked(succ))
+                {
+                    curr = toNode(succ);
+                    continue;
+                }
+
+                if (!(curr->key < key))
+                    break;
+                pred = curr;
+                curr = toNode(succ);
+            }
+        }
+        return curr;
+    }
+
+    /*
+    Called once by the inserter when it stops linking levels and once by the eraser.
+    If the node is marked, a search unlinks it from every level it is still on; the
+    second caller has run that search after all of its own links, so the node is
+    unreachable for new operations and can be retired.
+    */
+    void release(Node *node)
+    {
+        if (isMarked(loadLink(node->next()[0])))
+        {
+            Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+            search(node->key, preds, succs);
+        }
+
+        int owners;
+        #pragma omp atomic capture
+        owners = --node->owners;
+        if (owners == 0)
+            epochs_.retire(node);
+    }
+
+    Node *const head_;
+    EpochManager<Node> epochs_;
+};
+
+// baseline: one std::map, every operation inside the same critical section
+template <typename K, typename V>
+class CriticalMap
+{
+public:
+    bool insert(const K &key, const V &value)
+    {
+        bool inserted;
+        #pragma omp critical(criticalMap)
+        inserted = map_.emplace(key, value).second;
+        return inserted;
+    }
+
+    bool erase(const K &key)
+    {
+        bool erased;
+        #pragma omp critical(criticalMap)
+        erased = map_.erase(key) > 0;
+        return erased;
+    }
+
+    bool find(const K &key, V &value)
+    {
+        bool found;
+        #pragma omp critical(criticalMap)
+        {
+            auto it = map_.find(key);
+            found = it != map_.end();
+            if (found)
+                value = it->second;
+        }
+        return found;
+    }
+
+    template <typename F>
+    void forRange(const K &lo, const K &hi, F visit)
+    {
+        #pragma omp critical(criticalMap)
+        {
+            for (auto it = map_.lower_bound(lo); it != map_.end() && it->first < hi; ++it)
+                visit(it->first, it->second);
+        }
+    }
+
+private:
+    map<K, V> map_;
+};
+
+/*
+baseline: keys are spread over STRIPES maps by hash, each with its own lock. Point
+operations rarely contend, but a range scan has to lock and search every stripe,
+then sort what it collected.
+*/
+template <typename K, typename V>
+class StripedMap
+{
+public:
+    static constexpr size_t STRIPES = 64;
+
+    StripedMap()
+        : stripes_(STRIPES)
+    {
+        for (Stripe &stripe : stripes_)
+            omp_init_lock(&stripe.lock);
+    }
+
+    ~StripedMap()
+    {
+        for (Stripe &stripe : stripes_)
+            omp_destroy_lock(&stripe.lock);
+    }
+
+    StripedMap(const StripedMap &) = delete;
+    StripedMap &operator=(const StripedMap &) = delete;
+
+    bool insert(const K &key, const V &value)
+    {
+        Stripe &stripe = stripeFor(key);
+        omp_set_lock(&stripe.lock);
+        bool inserted = stripe.entries.emplace(key, value).second;
+        omp_unset_lock(&stripe.lock);
+        return inserted;
+    }
+
+    bool erase(const K &key)
+    {
+        Stripe &stripe = stripeFor(key);
+        omp_set_lock(&stripe.lock);
+        bool erased = stripe.entries.erase(key) > 0;
+        omp_unset_lock(&stripe.lock);
+        return erased;
+    }
+
+    bool find(const K &key, V &value)
+    {
+        Stripe &stripe = stripeFor(key);
+        omp_set_lock(&stripe.lock);
+        auto it = stripe.entries.find(key);
+        bool found = it != stripe.entries.end();
+        if (found)
+            value = it->second;
+        omp_unset_lock(&stripe.lock);
+        return found;
+    }
+
+    template <typename F>
+    void forRange(const K &lo, const K &hi, F visit)
+    {
+        vector<pair<K, V>> inRange;
+        for (Stripe &stripe : stripes_)
+        {
+            omp_set_lock(&stripe.lock);
+            for (auto it = stripe.entries.lower_bound(lo); it != stripe.entries.end() && it->first < hi; ++it)
+                inRange.push_back(*it);
+            omp_unset_lock(&stripe.lock);
+        }
+
+        sort(inRange.begin(), inRange.end(),
+             [](const pair<K, V> &a, const pair<K, V> &b) { return a.first < b.first; });
+        for (const auto &[key, value] : inRange)
+            visit(key, value);
+    }
+
+private:
+    struct alignas(64) Stripe
+    {
+        omp_lock_t lock;
+        map<K, V> entries;
+    };
+
+    Stripe &stripeFor(const K &key)
+    {
+        // the top bits of a multiplicative hash, so neighbouring keys land on different stripes
+        uint64_t h = hash<K>{}(key) * 0x9E3779B97F4A7C15ull;
+        return stripes_[h >> (64 - countr_zero(STRIPES))];
+    }
+
+    vector<Stripe> stripes_;
+};
+
+// the keys in [lo, hi) in the order forRange visits them
+template <typename Map>
+vector<int> keysInRange(Map &map, int lo, int hi)
+{
+    vector<int> keys;
+    map.forRange(lo, hi, [&](int key, int) { keys.push_back(key); });
+    return keys;
+}
+
+void testEpochManager()
+{
+    static int freed = 0;
+    EpochManager<int> epochs([](int *node) { ++freed; delete node; });
+
+    // a thread inside an operation holds the epoch back: nothing it could see is freed
+    epochs.enter();
+    epochs.retire(new int(1));
+    epochs.retire(new int(2));
+    for (int i = 0; i < 3; ++i)
+        epochs.reclaim();
+    assert(freed == 0);
+    assert(epochs.pending() == 2);
+
+    // two more epochs after leaving, and both are gone
+    epochs.exit();
+    for (int i = 0; i < 2; ++i)
+        epochs.reclaim();
+    assert(freed == 2);
+    assert(epochs.pending() == 0);
+
+    // leftovers are freed by the destructor
+    {
+        EpochManager<int> scoped([](int *node) { ++freed; delete node; });
+        scoped.retire(new int(3));
+    }
+    assert(freed == 3);
+}
+
+void testSkipListSingleThread()
+{
+    SkipList<int, int> list;
+    int value = 0;
+    assert(!list.find(5, value));
+    assert(!list.erase(5));
+
+    // insert out of order; the list keeps keys sorted
+    for (int key : {5, 1, 9, 3, 7})
+        assert(list.insert(key, key * 10));
+    assert(!list.insert(3, 0)); // duplicate keys are rejected and keep the old value
+
+    assert(list.find(3, value) && value == 30);
+    assert(!list.find(4, value));
+    assert(keysInRange(list, 0, 100) == vector<int>({1, 3, 5, 7, 9}));
+    assert(keysInRange(list, 3, 7) == vector<int>({3, 5})); // [lo, hi)
+    assert(keysInRange(list, 10, 20).empty());
+
+    assert(list.erase(5));
+    assert(!list.erase(5));
+    assert(!list.contains(5));
+    assert(keysInRange(list, 0, 100) == vector<int>({1, 3, 7, 9}));
+
+    // a key can come back after it was erased
+    assert(list.insert(5, 55));
+    assert(list.find(5, value) && value == 55);
+}
+
+void testSkipListReclamation()
+{
+    const int n = 1000;
+    SkipList<int, int> list;
+    for (int i = 0; i < n; ++i)
+        list.insert(i, i);
+    for (int i = 0; i < n; ++i)
+        assert(list.erase(i));
+    assert(keysInRange(list, 0, n).empty());
+
+    // every erased node is retired; with no thread inside an operation all of them can be freed
+    for (int i = 0; i < 2; ++i)
+        list.reclaim();
+    assert(list.pendingReclaim() == 0);
+}
+
+// every key is inserted by two threads at once: exactly one insert succeeds
+template <typename Map>
+void testConcurrentInserts(int threads)
+{
+    const int n = 20'000;
+    Map map;
+    int succeeded = 0;
+
+    #pragma omp parallel for num_threads(threads) schedule(dynamic, 16) reduction(+ : succeeded)
+    for (int i = 0; i < 2 * n; ++i)
+    {
+        const int key = (i / 2) * 7919 % n; // scattered order
+        succeeded += map.insert(key, -key);
+    }
+    assert(succeeded == n);
+
+    vector<int> expected(n);
+    for (int i = 0; i < n; ++i)
+        expected[i] = i;
+    assert(keysInRange(map, 0, n) == expected);
+
+    int value = 0;
+    assert(map.find(n / 2, value) && value == -(n / 2));
+}
+
+/*
+Threads insert the even keys and erase the pre-inserted odd keys, while every thread
+also scans the whole range before and after its share. Scans must always see sorted,
+unique keys with their own values, whatever is being changed around them.
+*/
+void testSkipListConcurrentInsertErase(int threads)
+{
+    const int n = 20'000;
+    SkipList<int, int> list;
+    for (int key = 1; key < n; key += 2)
+        list.insert(key, key);
+
+    auto checkScan = [&]()
+    {
+        int previous = -1;
+        list.forRange(0, n, [&](int key, int value)
+        {
+            assert(key > previous);
+            assert(value == key);
+            previous = key;
+        });
+    };
+
+    int erased = 0;
+    #pragma omp parallel num_threads(threads) reduction(+ : erased)
+    {
+        checkScan();
+
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (int key = 0; key < n; ++key)
+        {
+            if (key % 2 == 0)
+                assert(list.insert(key, key));
+            else
+                erased += list.erase(key);
+        }
+
+        checkScan();
+    }
+    assert(erased == n / 2);
+
+    const vector<int> keys = keysInRange(list, 0, n);
+    assert((int)keys.size() == n / 2);
+    for (int i = 0; i < (int)keys.size(); ++i)
+        assert(keys[i] == 2 * i);
+}
+
+void test()
+{
+    testEpochManager();
+    testSkipListSingleThread();
+    testSkipListReclamation();
+
+    for (int threads : {1, 2, 4, 8})
+    {
+        testConcurrentInserts<SkipList<int, int>>(threads);
+        testConcurrentInserts<CriticalMap<int, int>>(threads);
+        testConcurrentInserts<StripedMap<int, int>>(threads);
+        testSkipListConcurrentInsertErase(threads);
+    }
+}
+
+inline uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/*
+Inserts 'keys' with 'threads' threads, then runs 'ops' mixed operations:
+80% find, 15% insert of a new key, 5% scan of a range that holds about 16 keys.
+Keys are drawn from [0, 4n), so a quarter of the key space is filled.
+Returns {insert Mops/s, mixed Mops/s}.
+*/
+template <typename Map>
+pair<double, double> mopsPerSecond(const vector<uint64_t> &keys, int threads, long long ops)
+{
+    const long long n = keys.size();
+    const uint64_t keySpace = 4 * n;
+    Map map;
+
+    auto start = chrono::steady_clock::now();
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (long long i = 0; i < n; ++i)
+        map.insert(keys[i], i);
+    chrono::duration<double> insertTime = chrono::steady_clock::now() - start;
+
+    long long checksum = 0;
+    start = chrono::steady_clock::now();
+    #pragma omp parallel for num_threads(threads) schedule(static) reduction(+ : checksum)
+    for (long long i = 0; i < ops; ++i)
+    {
+        const uint64_t r = splitMix64(i);
+        const uint64_t key = (r >> 8) % keySpace;
+        const int kind = r % 100;
+        long long value = 0;
+        if (kind < 80)
+            checksum += map.find(key, value);
+        else if (kind < 95)
+            checksum += map.insert(key, i);
+        else
+            map.forRange(key, key + 64, [&](uint64_t, long long) { ++checksum; });
+    }
+    chrono::duration<double> mixedTime = chrono::steady_clock::now() - start;
+
+    assert(checksum > 0);
+    return {n / insertTime.count() / 1e6, ops / mixedTime.count() / 1e6};
+}
+
+/* Sample output (1 core, 4 threads):
+200000 inserts, then 400000 mixed operations (80% find, 15% insert, 5% range scan)
+threads  insert Mops/s: skip list / critical / striped   mixed Mops/s: skip list / critical / striped
+1	 1.59554 / 1.55899 / 2.38332			     1.13162 / 1.24841 / 0.40631
+2	 1.7667 / 1.16121 / 1.78078			     1.23704 / 1.1853 / 0.343259
+4	 1.49966 / 1.78656 / 1.77654			     1.25695 / 1.23698 / 0.358975
+One core can't show scaling; the striped map pays for every range scan by visiting all 64 stripes.
+*/
+void benchmark(long long n)
+{
+    const int maxThreads = omp_get_max_threads();
+    const long long ops = 2 * n;
+
+    // distinct keys in random order
+    vector<uint64_t> keys(4 * n);
+    for (long long i = 0; i < 4 * n; ++i)
+        keys[i] = i;
+    shuffle(keys.begin(), keys.end(), mt19937_64(1));
+    keys.resize(n);
+
+    cout << n << " inserts, then " << ops << " mixed operations (80% find, 15% insert, 5% range scan)\n";
+    cout << "threads  insert Mops/s: skip list / critical / striped   mixed Mops/s: skip list / critical / striped\n";
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        auto skipList = mopsPerSecond<SkipList<uint64_t, long long>>(keys, threads, ops);
+        auto critical = mopsPerSecond<CriticalMap<uint64_t, long long>>(keys, threads, ops);
+        auto striped = mopsPerSecond<StripedMap<uint64_t, long long>>(keys, threads, ops);
+        cout << threads << "\t " << skipList.first << " / " << critical.first << " / " << striped.first
+             << "\t\t\t     " << skipList.second << " / " << critical.second << " / " << striped.second << '\n';
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const long long n = argc > 1 ? stoll(argv[1]) : 200'000;
+
+    test();
+    benchmark(n);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,462 @@
+/*
+A Jacobi stencil updates every grid point from its neighbors' values
+at the previous time step. Each step reads one buffer and writes the
+other, so all threads must finish step t before any thread starts
+step t+1. This is the classic use of a barrier (see Barrier.cpp).
+
+2D 5-point heat:  u'[y][x]    = u + a * (N + S + E + W - 4u)
+3D 7-point heat:  u'[z][y][x] = u + a * (N + S + E + W + U + D - 6u)
+
+Three versions of each kernel:
+1. naive:    one '#pragma omp for' per time step. The implicit barrier at
+             the end of the loop separates the steps.
+2. tiled:    '#pragma omp for collapse(2)' over cache-sized tiles with
+             '#pragma omp simd' on the unit-stride inner loop.
+3. temporal: wavefront (time-skewed) blocking. The grid is cut into bands of
+             rows (2D) or planes (3D). A band is advanced T steps while it
+             is still in cache, shifting back by one row per step so the
+             dependencies on the previous band are always satisfied. This
+             cuts memory traffic by up to T times.
+
+Effective bandwidth counts one read and one write of a double per update
+(16 bytes), which is the traffic of the naive kernel. Temporal blocking can
+report more than the hardware bandwidth because it avoids that traffic.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+constexpr double ALPHA = 0.1;
+
+// tile sizes for the spatially tiled kernels
+constexpr int TILE_Y = 16;
+constexpr int TILE_X = 512;
+
+// number of time steps a band is advanced before moving to the next band
+constexpr int TIME_BLOCK = 8;
+
+// grid with a fixed (Dirichlet) boundary of one cell on each side
+struct Grid2D
+{
+    int nx{}, ny{};
+    vector<double> data;
+
+    Grid2D(int nx, int ny)
+        : nx(nx), ny(ny), data(size_t(nx) * ny, 0.0)
+    {
+    }
+
+    double &at(int y, int x) { return data[size_t(y) * nx + x]; }
+};
+
+struct Grid3D
+{
+    int nx{}, ny{}, nz{};
+    vector<double> data;
+
+    Grid3D(int nx, int ny, int nz)
+        : nx(nx), ny(ny), nz(nz), data(size_t(nx) * ny * nz, 0.0)
+    {
+    }
+
+    double &at(int z, int y, int x) { return data[(size_t(z) * ny + y) * nx + x]; }
+};
+
+// update row y of a 2D grid for x in [x0, x1)
+inline void updateRow2D(const double *in, double *out, int nx, int y, int x0, int x1)
+{
+    const double *c = in + size_t(y) * nx;
+    const double *n = c - nx;
+    const double *s = c + nx;
+    double *o = out + size_t(y) * nx;
+
+    #pragma omp simd
+    for (int x = x0; x < x1; ++x)
+        o[x] = c[x] + ALPHA * (n[x] + s[x] + c[x - 1] + c[x + 1] - 4.0 * c[x]);
+}
+
+// update row (z, y) of a 3D grid for x in [x0, x1)
+inline void updateRow3D(const double *in, double *out, int nx, int ny, int z, int y, int x0, int x1)
+{
+    const size_t plane = size_t(nx) * ny;
+    const double *c = in + z * plane + size_t(y) * nx;
+    const double *n = c - nx;
+    const double *s = c + nx;
+    const double *u = c - plane;
+    const double *d = c + plane;
+    double *o = out + z * plane + size_t(y) * nx;
+
+    #pragma omp simd
+    for (int x = x0; x < x1; ++x)
+        o[x] = c[x] + ALPHA * (n[x] + s[x] + c[x - 1] + c[x + 1] + u[x] + d[x] - 6.0 * c[x]);
+}
+
+// the result of all kernels is left in 'a'. 'b' is scratch and must hold the same boundary.
+void jacobi2dNaive(Grid2D &a, Grid2D &b, int steps)
+{
+    const int nx = a.nx, ny = a.ny;
+
+    #pragma omp parallel
+    {
+        // each thread swaps its own copy of the pointers so no shared update is needed
+        double *in = a.data.data();
+        double *out = b.data.data();
+
+        for (int t = 0; t < steps; ++t)
+        {
+            // implicit barrier at the end of 'for' completes step t for all threads
+            #pragma omp for schedule(static)
+            for (int y = 1; y < ny - 1; ++y)
+                updateRow2D(in, out, nx, y, 1, nx - 1);
+
+            swap(in, out);
+        }
+    }
+
+    if (steps % 2 == 1)
+        swap(a.data, b.data);
+}
+
+void jacobi2dTiled(Grid2D &a, Grid2D &b, int steps)
+{
+    const int nx = a.nx, ny = a.ny;
+    const int tilesY = (ny - 2 + TILE_Y - 1) / TILE_Y;
+    const int tilesX = (nx - 2 + TILE_X - 1) / TILE_X;
+
+    #pragma omp parallel
+    {
+        double *in = a.data.data();
+        double *out = b.data.data();
+
+        for (int t = 0; t < steps; ++t)
+        {
+            // collapse(2) distributes the 2D tile space rather than only the rows
+            #pragma omp for collapse(2) schedule(static)
+            for (int ty = 0; ty < tilesY; ++ty)
+            {
+                for (int tx = 0; tx < tilesX; ++tx)
+                {
+                    const int y0 = 1 + ty * TILE_Y, y1 = min(y0 + TILE_Y, ny - 1);
+                    const int x0 = 1 + tx * TILE_X, x1 = min(x0 + TILE_X, nx - 1);
+                    for (int y = y0; y < y1; ++y)
+                        updateRow2D(in, out, nx, y, x0, x1);
+                }
+            }
+
+            swap(in, out);
+        }
+    }
+
+    if (steps % 2 == 1)
+        swap(a.data, b.data);
+}
+
+/*
+Wavefront temporal blocking. Band 'k' covers rows [lo - s, hi - s) at step s
+of the current time block, so row y at step s only needs rows y-1..y+1 from
+step s-1, which were produced either earlier in this band or by band k-1.
+The whole team works on one band at a time and a barrier separates its steps.
+*/
+void jacobi2dTemporal(Grid2D &a, Grid2D &b, int steps, int bandRows = 64)
+{
+    const int nx = a.nx, ny = a.ny;
+
+    #pragma omp parallel
+    {
+        for (int t0 = 0; t0 < steps; t0 += TIME_BLOCK)
+        {
+            const int T = min(TIME_BLOCK, steps - t0);
+
+            // bands extend past the bottom edge by T rows so the last skewed band reaches it
+            for (int lo = 1; lo < ny - 1 + T; lo += bandRows)
+            {
+                for (int s = 0; s < T; ++s)
+                {
+                    const double *in = ((t0 + s) % 2 == 0) ? a.data.data() : b.data.data();
+                    double *out = ((t0 + s) % 2 == 0) ? b.data.data() : a.data.data();
+
+                    const int y0 = max(1, lo - s);
+                    const int y1 = min(ny - 1, lo + bandRows - s);
+
+                    #pragma omp for schedule(static)
+                    for (int y = y0; y < y1; ++y)
+                        updateRow2D(in, out, nx, y, 1, nx - 1);
+                }
+            }
+        }
+    }
+
+    if (steps % 2 == 1)
+        swap(a.data, b.data);
+}
+
+void jacobi3dNaive(Grid3D &a, Grid3D &b, int steps)
+{
+    const int nx = a.nx, ny = a.ny, nz = a.nz;
+
+    #pragma omp parallel
+    {
+        double *in = a.data.data();
+        double *out = b.data.data();
+
+        for (int t = 0; t < steps; ++t)
+        {
+            #pragma omp for schedule(static)
+            for (int z = 1; z < nz - 1; ++z)
+                for (int y = 1; y < ny - 1; ++y)
+                    updateRow3D(in, out, nx, ny, z, y, 1, nx - 1);
+
+            swap(in, out);
+        }
+    }
+
+    if (steps % 2 == 1)
+        swap(a.data, b.data);
+}
+
+void jacobi3dTiled(Grid3D &a, Grid3D &b, int steps)
+{
+    const int nx = a.nx, ny = a.ny, nz = a.nz;
+    const int tilesY = (ny - 2 + TILE_Y - 1) / TILE_Y;
+
+    #pragma omp parallel
+    {
+        double *in = a.data.data();
+        double *out = b.data.data();
+
+        for (int t = 0; t < steps; ++t)
+        {
+            // (plane, row tile) pairs give enough parallelism even for few planes
+            #pragma omp for collapse(2) schedule(static)
+            for (int z = 1; z < nz - 1; ++z)
+            {
+                for (int ty = 0; ty < tilesY; ++ty)
+                {
+                    const int y0 = 1 + ty * TILE_Y, y1 = min(y0 + TILE_Y, ny - 1);
+                    for (int y = y0; y < y1; ++y)
+                        updateRow3D(in, out, nx, ny, z, y, 1, nx - 1);
+                }
+            }
+
+            swap(in, out);
+        }
+    }
+
+    if (steps % 2 == 1)
+        swap(a.data, b.data);
+}
+
+// same wavefront scheme as jacobi2dTemporal, skewed over planes instead of rows
+void jacobi3dTemporal(Grid3D &a, Grid3D &b, int steps, int bandPlanes = 4)
+{
+    const int nx = a.nx, ny = a.ny, nz = a.nz;
+
+    #pragma omp parallel
+    {
+        for (int t0 = 0; t0 < steps; t0 += TIME_BLOCK)
+        {
+            const int T = min(TIME_BLOCK, steps - t0);
+
+            for (int lo = 1; lo < nz - 1 + T; lo += bandPlanes)
+            {
+                for (int s = 0; s < T; ++s)
+                {
+                    const double *in = ((t0 + s) % 2 == 0) ? a.data.data() : b.data.data();
+                    double *out = ((t0 + s) % 2 == 0) ? b.data.data() : a.data.data();
+
+                    const int z0 = max(1, lo - s);
+                    const int z1 = min(nz - 1, lo + bandPlanes - s);
+
+                    #pragma omp for collapse(2) schedule(static)
+                    for (int z = z0; z < z1; ++z)
+                        for (int y = 1; y < ny - 1; ++y)
+                            updateRow3D(in, out, nx, ny, z, y, 1, nx - 1);
+                }
+            }
+        }
+    }
+
+    if (steps % 2 == 1)
+        swap(a.data, b.data);
+}
+
+// hot left edge, cold elsewhere
+void initGrid(Grid2D &g)
+{
+    fill(g.data.begin(), g.data.end(), 0.0);
+    for (int y = 0; y < g.ny; ++y)
+        g.at(y, 0) = 100.0;
+}
+
+// hot bottom plane, cold elsewhere
+void initGrid(Grid3D &g)
+{
+    fill(g.data.begin(), g.data.end(), 0.0);
+    for (int y = 0; y < g.ny; ++y)
+        for (int x = 0; x < g.nx; ++x)
+            g.at(0, y, x) = 100.0;
+}
+
+// single-threaded reference with no tiling, used to validate the kernels
+template <typename Grid, typename RowUpdate>
+void referenceSteps(Grid &a, int steps, RowUpdate rowUpdate)
+{
+    Grid b = a;
+    for (int t = 0; t < steps; ++t)
+    {
+        rowUpdate(a.data.data(), b.data.data());
+        swap(a.data, b.data);
+    }
+}
+
+double maxDifference(const vector<double> &x, const vector<double> &y)
+{
+    double diff = 0.0;
+    for (size_t i = 0; i < x.size(); ++i)
+        diff = max(diff, fabs(x[i] - y[i]));
+    return diff;
+}
+
+void testJacobi2D()
+{
+    // odd sizes and step counts exercise partial tiles and the final buffer swap
+    const int nx = 203, ny = 157, steps = 21;
+
+    Grid2D expected(nx, ny);
+    initGrid(expected);
+    referenceSteps(expected, steps, [&](const double *in, double *out) {
+        for (int y = 1; y < ny - 1; ++y)
+            updateRow2D(in, out, nx, y, 1, nx - 1);
+    });
+
+    using Kernel = void (*)(Grid2D &, Grid2D &, int);
+    const Kernel kernels[] = {
+        jacobi2dNaive,
+        jacobi2dTiled,
+        [](Grid2D &a, Grid2D &b, int s) { jacobi2dTemporal(a, b, s, 10); }};
+
+    for (Kernel kernel : kernels)
+    {
+        Grid2D a(nx, ny), b(nx, ny);
+        initGrid(a);
+        initGrid(b);
+        kernel(a, b, steps);
+        assert(maxDifference(a.data, expected.data) < 1e-12);
+    }
+
+    // heat flows in from the left edge
+    assert(expected.at(ny / 2, 1) > expected.at(ny / 2, 2));
+    assert(expected.at(ny / 2, 2) > 0.0);
+}
+
+void testJacobi3D()
+{
+    const int nx = 37, ny = 29, nz = 31, steps = 19;
+
+    Grid3D expected(nx, ny, nz);
+    initGrid(expected);
+    referenceSteps(expected, steps, [&](const double *in, double *out) {
+        for (int z = 1; z < nz - 1; ++z)
+            for (int y = 1; y < ny - 1; ++y)
+                updateRow3D(in, out, nx, ny, z, y, 1, nx - 1);
+    });
+
+    using Kernel = void (*)(Grid3D &, Grid3D &, int);
+    const Kernel kernels[] = {
+        jacobi3dNaive,
+        jacobi3dTiled,
+        [](Grid3D &a, Grid3D &b, int s) { jacobi3dTemporal(a, b, s, 3); }};
+
+    for (Kernel kernel : kernels)
+    {
+        Grid3D a(nx, ny, nz), b(nx, ny, nz);
+        initGrid(a);
+        initGrid(b);
+        kernel(a, b, steps);
+        assert(maxDifference(a.data, expected.data) < 1e-12);
+    }
+
+    assert(expected.at(1, ny / 2, nx / 2) > expected.at(2, ny / 2, nx / 2));
+}
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void report(const string &name, double updates, double seconds)
+{
+    cout << "  " << name << ": " << updates / seconds / 1e6 << " Mupdates/s, "
+         << updates * 2 * sizeof(double) / seconds / 1e9 << " GB/s effective\n";
+}
+
+/* Sample output:
+Jacobi 2D 2048x2048, 40 steps
+  naive: 344.513 Mupdates/s, 5.51222 GB/s effective
+  tiled: 338.911 Mupdates/s, 5.42257 GB/s effective
+  temporal: 814.923 Mupdates/s, 13.0388 GB/s effective
+Jacobi 3D 160^3, 40 steps
+  naive: 392.173 Mupdates/s, 6.27476 GB/s effective
+  tiled: 393.883 Mupdates/s, 6.30213 GB/s effective
+  temporal: 525.15 Mupdates/s, 8.4024 GB/s effective
+*/
+void benchmark()
+{
+    {
+        const int n = 2048, steps = 40;
+        const double updates = double(n - 2) * (n - 2) * steps;
+        cout << "Jacobi 2D " << n << "x" << n << ", " << steps << " steps\n";
+
+        Grid2D a(n, n), b(n, n);
+        initGrid(a), initGrid(b);
+        report("naive", updates, secondsFor([&] { jacobi2dNaive(a, b, steps); }));
+        initGrid(a), initGrid(b);
+        report("tiled", updates, secondsFor([&] { jacobi2dTiled(a, b, steps); }));
+        initGrid(a), initGrid(b);
+        report("temporal", updates, secondsFor([&] { jacobi2dTemporal(a, b, steps); }));
+    }
+
+    {
+        const int n = 160, steps = 40;
+        const double updates = double(n - 2) * (n - 2) * (n - 2) * steps;
+        cout << "Jacobi 3D " << n << "^3, " << steps << " steps\n";
+
+        Grid3D a(n, n, n), b(n, n, n);
+        initGrid(a), initGrid(b);
+        report("naive", updates, secondsFor([&] { jacobi3dNaive(a, b, steps); }));
+        initGrid(a), initGrid(b);
+        report("tiled", updates, secondsFor([&] { jacobi3dTiled(a, b, steps); }));
+        initGrid(a), initGrid(b);
+        report("temporal", updates, secondsFor([&] { jacobi3dTemporal(a, b, steps); }));
+    }
+}
+
+void test()
+{
+    testJacobi2D();
+    testJacobi3D();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
@@ -0,0 +1,430 @@
+/*
+Strassen's algorithm multiplies two N x N matrices with 7 half-size products
+instead of 8, so it runs in O(N^2.81) instead of O(N^3):
+https://en.wikipedia.org/wiki/Strassen_algorithm
+
+M1 = (A11 + A22)(B11 + B22)     C11 = M1 + M4 - M5 + M7
+M2 = (A21 + A22) B11            C12 = M3 + M5
+M3 = A11 (B12 - B22)            C21 = M2 + M4
+M4 = A22 (B21 - B11)            C22 = M1 - M2 + M3 + M6
+M5 = (A11 + A12) B22
+M6 = (A21 - A11)(B11 + B12)
+M7 = (A12 - A22)(B21 + B22)
+
+The 7 products are independent, so the top levels of the recursion run them as
+'#pragma omp task's. Deeper levels recurse serially inside each task. Below
+'cutoff' the extra additions cost more than they save, so a blocked GEMM is used.
+
+All temporaries come from one workspace allocated up front. Every task gets its
+own slice, so the recursion never allocates and tasks never share buffers.
+The workspace is about 7 N^2 doubles with one task level and 17 N^2 with two.
+
+Sizes that don't halve evenly down to the cutoff are zero-padded to the next
+size that does (at most 2^levels - 1 extra rows and columns).
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// N x N row-major matrix
+using Matrix = vector<double>;
+
+// square sub-matrix with a row stride
+struct View
+{
+    double *p;
+    size_t ld;
+
+    double *row(int i) const { return p + size_t(i) * ld; }
+    View quadrant(int r, int c, int h) const { return {p + size_t(r) * h * ld + size_t(c) * h, ld}; }
+};
+
+// classic kernel with the outer loop parallelized, as matrixMultiply in ParallelFor.cpp
+void classicMultiply(const Matrix &A, const Matrix &B, Matrix &C, int n)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < n; ++k)
+                sum += A[size_t(i) * n + k] * B[size_t(k) * n + j];
+            C[size_t(i) * n + j] = sum;
+        }
+    }
+}
+
+// base case block size: a TILE x TILE block of B (32 KB) stays in cache while every row of A uses it
+constexpr int TILE = 64;
+
+/*
+C = A * B for the base case, blocked over k and j. Inside a block: i-k-j order with a
+vectorized unit-stride inner loop. Every C element still sums over k in increasing
+order, so the result is the same as the unblocked loop.
+*/
+void gemmBase(View A, View B, View C, int n)
+{
+    for (int i = 0; i < n; ++i)
+        fill(C.row(i), C.row(i) + n, 0.0);
+
+    for (int kk = 0; kk < n; kk += TILE)
+    {
+        const int kEnd = min(kk + TILE, n);
+        for (int jj = 0; jj < n; jj += TILE)
+        {
+            const int jEnd = min(jj + TILE, n);
+            for (int i = 0; i < n; ++i)
+            {
+                double *c = C.row(i);
+                for (int k = kk; k < kEnd; ++k)
+                {
+                    const double a = A.row(i)[k];
+                    const double *b = B.row(k);
+
+                    #pragma omp simd
+                    for (int j = jj; j < jEnd; ++j)
+                        c[j] += a * b[j];
+                }
+            }
+        }
+    }
+}
+
+// Z = X + sign * Y
+void addScaled(View X, View Y, View Z, int n, double sign)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        const double *x = X.row(i), *y = Y.row(i);
+        double *z = Z.row(i);
+
+        #pragma omp simd
+        for (int j = 0; j < n; ++j)
+            z[j] = x[j] + sign * y[j];
+    }
+}
+
+// operands of product M(i+1): (A left [+- A right]) * (B left [+- B right])
+struct ProductTerms
+{
+    int aLeft, aRight, aSign;  // quadrant indices 0..3 = 11, 12, 21, 22. aRight < 0: no sum.
+    int bLeft, bRight, bSign;
+};
+
+constexpr ProductTerms PRODUCTS[7] = {
+    {0, 3, +1, 0, 3, +1},  // M1 = (A11 + A22)(B11 + B22)
+    {2, 3, +1, 0, -1, 0},  // M2 = (A21 + A22) B11
+    {0, -1, 0, 1, 3, -1},  // M3 = A11 (B12 - B22)
+    {3, -1, 0, 2, 0, -1},  // M4 = A22 (B21 - B11)
+    {0, 1, +1, 3, -1, 0},  // M5 = (A11 + A12) B22
+    {2, 0, -1, 0, 1, +1},  // M6 = (A21 - A11)(B11 + B12)
+    {1, 3, -1, 2, 3, +1},  // M7 = (A12 - A22)(B21 + B22)
+};
+
+// sign of M(p+1) in each C quadrant
+constexpr int COMBINE[4][7] = {
+    {+1, 0, 0, +1, -1, 0, +1}, // C11
+    {0, 0, +1, 0, +1, 0, 0},   // C12
+    {0, +1, 0, +1, 0, 0, 0},   // C21
+    {+1, -1, +1, 0, 0, +1, 0}, // C22
+};
+
+class StrassenMultiplier
+{
+public:
+    // n: matrix size. cutoff: largest size multiplied with plain GEMM.
+    // taskLevels: recursion levels that spawn tasks (7^taskLevels tasks); -1 picks enough for the team.
+    StrassenMultiplier(int n, int cutoff = 128, int taskLevels = -1)
+        : n_(n), cutoff_(cutoff)
+    {
+        // halve until the blocks fit the cutoff, then round n up so every level halves evenly
+        int levels = 0;
+        while (((n + (1 << levels) - 1) >> levels) > cutoff)
+            ++levels;
+        const int block = (n + (1 << levels) - 1) >> levels;
+        padded_ = block << levels;
+
+        if (taskLevels < 0)
+        {
+            taskLevels = 0;
+            for (int tasks = 1; tasks < omp_get_max_threads(); tasks *= 7)
+                ++taskLevels;
+        }
+        taskLevels_ = min(taskLevels, levels);
+
+        workspace_.resize(workspaceSize(padded_, taskLevels_));
+        if (padded_ != n_)
+        {
+            paddedA_.assign(size_t(padded_) * padded_, 0.0);
+            paddedB_.assign(size_t(padded_) * padded_, 0.0);
+            paddedC_.assign(size_t(padded_) * padded_, 0.0);
+        }
+    }
+
+    int paddedSize() const { return padded_; }
+    size_t workspaceBytes() const { return workspace_.size() * sizeof(double); }
+
+    // C = A * B. A, B and C are n x n row-major.
+    void multiply(const Matrix &A, const Matrix &B, Matrix &C)
+    {
+        const size_t ld = padded_;
+        View a{const_cast<double *>(A.data()), ld}, b{const_cast<double *>(B.data()), ld}, c{C.data(), ld};
+
+        if (padded_ != n_)
+        {
+            // the padding stays zero, so only the real rows are copied
+            for (int i = 0; i < n_; ++i)
+            {
+                copy_n(A.data() + size_t(i) * n_, n_, paddedA_.data() + i * ld);
+                copy_n(B.data() + size_t(i) * n_, n_, paddedB_.data() + i * ld);
+            }
+            a = {paddedA_.data(), ld};
+            b = {paddedB_.data(), ld};
+            c = {paddedC_.data(), ld};
+        }
+
+        #pragma omp parallel
+        {
+            #pragma omp single
+            recurse(a, b, c, padded_, workspace_.data(), taskLevels_);
+        }
+
+        if (padded_ != n_)
+        {
+            for (int i = 0; i < n_; ++i)
+                copy_n(paddedC_.data() + i * ld, n_, C.data() + size_t(i) * n_);
+        }
+    }
+
+private:
+    // doubles needed by recurse(n, taskLevels)
+    size_t workspaceSize(int n, int taskLevels) const
+    {
+        if (n <= cutoff_)
+            return 0;
+
+        const size_t h = n / 2;
+        if (taskLevels == 0)
+            return 3 * h * h + workspaceSize(n / 2, 0); // operands and product, reused for all 7
+
+        return 7 * (3 * h * h + workspaceSize(n / 2, taskLevels - 1)); // one slice per task
+    }
+
+    // computes M(p+1) into M using T1 and T2 for the operand sums
+    void product(int p, View A, View B, int h, double *ws, View M, int taskLevels)
+    {
+        const ProductTerms &t = PRODUCTS[p];
+        const size_t hh = size_t(h) * h;
+        View T1{ws, size_t(h)}, T2{ws + hh, size_t(h)};
+
+        View left = A.quadrant(t.aLeft / 2, t.aLeft % 2, h);
+        if (t.aRight >= 0)
+        {
+            addScaled(left, A.quadrant(t.aRight / 2, t.aRight % 2, h), T1, h, t.aSign);
+            left = T1;
+        }
+
+        View right = B.quadrant(t.bLeft / 2, t.bLeft % 2, h);
+        if (t.bRight >= 0)
+        {
+            addScaled(right, B.quadrant(t.bRight / 2, t.bRight % 2, h), T2, h, t.bSign);
+            right = T2;
+        }
+
+        recurse(left, right, M, h, ws + 3 * hh, taskLevels);
+    }
+
+    // C quadrant q = sum of +-M over the products that contribute to it
+    static void combineQuadrant(int q, View C, const View *M, int h, int rowBegin, int rowEnd)
+    {
+        View Cq = C.quadrant(q / 2, q % 2, h);
+        for (int i = rowBegin; i < rowEnd; ++i)
+        {
+            double *c = Cq.row(i);
+            fill(c, c + h, 0.0);
+            for (int p = 0; p < 7; ++p)
+            {
+                if (COMBINE[q][p] == 0)
+                    continue;
+
+                const double sign = COMBINE[q][p];
+                const double *m = M[p].row(i);
+
+                #pragma omp simd
+                for (int j = 0; j < h; ++j)
+                    c[j] += sign * m[j];
+            }
+        }
+    }
+
+    void recurse(View A, View B, View C, int n, double *ws, int taskLevels)
+    {
+        if (n <= cutoff_)
+        {
+            gemmBase(A, B, C, n);
+            return;
+        }
+
+        const int h = n / 2;
+        const size_t hh = size_t(h) * h;
+
+        if (taskLevels == 0)
+        {
+            // serial: each product lands in one buffer and is added to C right away
+            View M{ws + 2 * hh, size_t(h)};
+            for (int q = 0; q < 4; ++q)
+            {
+                View Cq = C.quadrant(q / 2, q % 2, h);
+                for (int i = 0; i < h; ++i)
+                    fill(Cq.row(i), Cq.row(i) + h, 0.0);
+            }
+
+            for (int p = 0; p < 7; ++p)
+            {
+                product(p, A, B, h, ws, M, 0);
+                for (int q = 0; q < 4; ++q)
+                {
+                    if (COMBINE[q][p] != 0)
+                        addScaled(C.quadrant(q / 2, q % 2, h), M, C.quadrant(q / 2, q % 2, h), h, COMBINE[q][p]);
+                }
+            }
+            return;
+        }
+
+        // parallel: each task owns a workspace slice holding T1, T2 and its product M
+        const size_t slice = 3 * hh + workspaceSize(h, taskLevels - 1);
+        View M[7];
+        for (int p = 0; p < 7; ++p)
+            M[p] = {ws + p * slice + 2 * hh, size_t(h)};
+
+        for (int p = 0; p < 7; ++p)
+        {
+            #pragma omp task firstprivate(p)
+            product(p, A, B, h, ws + p * slice, M[p], taskLevels - 1);
+        }
+
+        #pragma omp taskwait // all 7 products are needed to form C
+
+        // combine rows of all 4 quadrants in parallel
+        #pragma omp taskloop collapse(2) grainsize(1)
+        for (int q = 0; q < 4; ++q)
+        {
+            for (int block = 0; block < 8; ++block)
+                combineQuadrant(q, C, M, h, block * h / 8, (block + 1) * h / 8);
+        }
+    }
+
+    const int n_;
+    const int cutoff_;
+    int padded_{};
+    int taskLevels_{};
+    vector<double> workspace_;
+    Matrix paddedA_, paddedB_, paddedC_;
+};
+
+// small integer entries keep every product and sum exact in double precision
+Matrix randomMatrix(int n, int seed)
+{
+    Matrix m(size_t(n) * n);
+    for (size_t i = 0; i < m.size(); ++i)
+        m[i] = double(int((i * 2654435761u + seed * 40503u) % 7) - 3);
+    return m;
+}
+
+void testStrassen()
+{
+    // sizes below, at and above the cutoff; powers of two and odd sizes that need padding
+    for (int n : {1, 7, 16, 17, 64, 100, 130, 257})
+    {
+        Matrix A = randomMatrix(n, 1), B = randomMatrix(n, 2);
+        Matrix expected(size_t(n) * n), C(size_t(n) * n);
+        classicMultiply(A, B, expected, n);
+
+        for (int taskLevels : {0, 1, 2})
+        {
+            StrassenMultiplier strassen(n, 16, taskLevels);
+            // padding is less than 2^levels, which is at most 2n / cutoff
+            assert(strassen.paddedSize() >= n && strassen.paddedSize() <= n + 2 * n / 16);
+
+            strassen.multiply(A, B, C);
+            assert(C == expected);
+
+            // the workspace is reused by a second call
+            fill(C.begin(), C.end(), -1.0);
+            strassen.multiply(A, B, C);
+            assert(C == expected);
+        }
+    }
+}
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output:
+N      padded  workspace MB  classic s  strassen s  speedup
+512    512     13.7626       0.354432   0.0335666   10.5591
+1000   1000    55.125        0.945575   0.239236    3.95248
+1024   1024    57.8028       9.9319     0.259134    38.3273
+*/
+void benchmark(const vector<int> &sizes)
+{
+    cout << "N      padded  workspace MB  classic s  strassen s  speedup\n";
+    for (int n : sizes)
+    {
+        Matrix A = randomMatrix(n, 1), B = randomMatrix(n, 2), C(size_t(n) * n), expected(size_t(n) * n);
+
+        // the classic kernel takes hours at 8192, so it is only timed up to 2048
+        double classic = 0.0;
+        if (n <= 2048)
+            classic = secondsFor([&] { classicMultiply(A, B, expected, n); });
+
+        StrassenMultiplier strassen(n);
+        double fast = secondsFor([&] { strassen.multiply(A, B, C); });
+        if (n <= 2048)
+            assert(C == expected);
+
+        cout << n << "\t" << strassen.paddedSize() << "\t" << strassen.workspaceBytes() / 1e6 << "\t      ";
+        if (classic > 0.0)
+            cout << classic << "\t " << fast << "\t     " << classic / fast << '\n';
+        else
+            cout << "-\t " << fast << "\t     -\n";
+    }
+}
+
+void test()
+{
+    testStrassen();
+}
+
+// usage: Strassen [N ...], e.g. Strassen 2048 4096 8192
+int main(int argc, char *argv[])
+{
+    test();
+
+    vector<int> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(stoi(argv[i]));
+    if (sizes.empty())
+        sizes = {512, 1000, 1024};
+    benchmark(sizes);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
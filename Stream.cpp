@@ -0,0 +1,434 @@
+/*
+STREAM measures sustainable memory bandwidth with four simple vector kernels:
+https://www.cs.virginia.edu/stream/
+
+copy:  c[i] = a[i]                (16 bytes per element)
+scale: b[i] = q * c[i]            (16 bytes per element)
+add:   c[i] = a[i] + b[i]         (24 bytes per element)
+triad: a[i] = b[i] + q * c[i]     (24 bytes per element)
+
+The arrays must be much larger than the last level cache. They are also
+initialized in parallel with the same static schedule as the kernels so
+each page is first touched (and placed in memory) by the thread that uses it.
+
+Normal stores read each destination cache line before writing it
+(write-allocate), so the hardware moves more bytes than STREAM counts.
+Non-temporal (streaming) stores skip that read and bypass the cache:
+#pragma omp simd nontemporal(list)
+
+The best bandwidth found is the memory roof of a roofline model. A kernel with
+arithmetic intensity I (flops per byte) can run at most min(peak flops, I * bandwidth).
+The results are written to a CSV file that other kernels' results can be plotted against.
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAS_STREAMING_STORES 1
+#endif
+
+using namespace std;
+
+constexpr double SCALAR = 3.0;
+constexpr int NTIMES = 10;
+
+// 64-byte aligned array of doubles. new[] without initializers leaves the pages untouched.
+class AlignedArray
+{
+public:
+    explicit AlignedArray(size_t n)
+        : data_(static_cast<double *>(::operator new[](n * sizeof(double), align_val_t(64))))
+    {
+    }
+
+    ~AlignedArray() { ::operator delete[](data_, align_val_t(64)); }
+
+    AlignedArray(const AlignedArray &) = delete;
+    AlignedArray &operator=(const AlignedArray &) = delete;
+
+    double *get() const { return data_; }
+
+private:
+    double *data_;
+};
+
+enum class Kernel
+{
+    Copy,
+    Scale,
+    Add,
+    Triad
+};
+
+const char *kernelName(Kernel k)
+{
+    switch (k)
+    {
+    case Kernel::Copy:  return "copy";
+    case Kernel::Scale: return "scale";
+    case Kernel::Add:   return "add";
+    case Kernel::Triad: return "triad";
+    }
+    return "";
+}
+
+size_t bytesPerElement(Kernel k)
+{
+    return (k == Kernel::Copy || k == Kernel::Scale) ? 2 * sizeof(double) : 3 * sizeof(double);
+}
+
+// parallel first touch: each thread initializes the pages it will later read and write
+void initArrays(double *a, double *b, double *c, size_t n, int threads)
+{
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t i = 0; i < n; ++i)
+    {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+}
+
+void runKernel(Kernel k, double *a, double *b, double *c, size_t n, int threads)
+{
+    switch (k)
+    {
+    case Kernel::Copy:
+        #pragma omp parallel for simd schedule(static) num_threads(threads)
+        for (size_t i = 0; i < n; ++i)
+            c[i] = a[i];
+        break;
+    case Kernel::Scale:
+        #pragma omp parallel for simd schedule(static) num_threads(threads)
+        for (size_t i = 0; i < n; ++i)
+            b[i] = SCALAR * c[i];
+        break;
+    case Kernel::Add:
+        #pragma omp parallel for simd schedule(static) num_threads(threads)
+        for (size_t i = 0; i < n; ++i)
+            c[i] = a[i] + b[i];
+        break;
+    case Kernel::Triad:
+        #pragma omp parallel for simd schedule(static) num_threads(threads)
+        for (size_t i = 0; i < n; ++i)
+            a[i] = b[i] + SCALAR * c[i];
+        break;
+    }
+}
+
+#ifdef HAS_STREAMING_STORES
+// stores 2 doubles without reading the destination line. dst must be 16-byte aligned.
+inline void streamStore(double *dst, double x0, double x1)
+{
+    _mm_stream_pd(dst, _mm_set_pd(x1, x0));
+}
+#endif
+
+/*
+Same kernels with non-temporal stores. The 'nontemporal' clause is only a hint
+(some compilers ignore it), so x86 builds issue the streaming stores directly.
+Work is split into 64-byte blocks so every thread's range stays aligned.
+*/
+void runKernelNonTemporal(Kernel k, double *a, double *b, double *c, size_t n, int threads)
+{
+    const long long blocks = static_cast<long long>(n / 8);
+
+#ifdef HAS_STREAMING_STORES
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp for schedule(static)
+        for (long long blk = 0; blk < blocks; ++blk)
+        {
+            const size_t i0 = size_t(blk) * 8;
+            for (size_t i = i0; i < i0 + 8; i += 2)
+            {
+                switch (k)
+                {
+                case Kernel::Copy:  streamStore(c + i, a[i], a[i + 1]); break;
+                case Kernel::Scale: streamStore(b + i, SCALAR * c[i], SCALAR * c[i + 1]); break;
+                case Kernel::Add:   streamStore(c + i, a[i] + b[i], a[i + 1] + b[i + 1]); break;
+                case Kernel::Triad: streamStore(a + i, b[i] + SCALAR * c[i], b[i + 1] + SCALAR * c[i + 1]); break;
+                }
+            }
+        }
+
+        // streaming stores are weakly ordered; fence before the implicit barrier publishes them
+        _mm_sfence();
+    }
+#else
+    switch (k)
+    {
+    case Kernel::Copy:
+        #pragma omp parallel for simd nontemporal(c) schedule(static) num_threads(threads)
+        for (long long i = 0; i < blocks * 8; ++i)
+            c[i] = a[i];
+        break;
+    case Kernel::Scale:
+        #pragma omp parallel for simd nontemporal(b) schedule(static) num_threads(threads)
+        for (long long i = 0; i < blocks * 8; ++i)
+            b[i] = SCALAR * c[i];
+        break;
+    case Kernel::Add:
+        #pragma omp parallel for simd nontemporal(c) schedule(static) num_threads(threads)
+        for (long long i = 0; i < blocks * 8; ++i)
+            c[i] = a[i] + b[i];
+        break;
+    case Kernel::Triad:
+        #pragma omp parallel for simd nontemporal(a) schedule(static) num_threads(threads)
+        for (long long i = 0; i < blocks * 8; ++i)
+            a[i] = b[i] + SCALAR * c[i];
+        break;
+    }
+#endif
+
+    // tail that does not fill a whole block
+    for (size_t i = size_t(blocks) * 8; i < n; ++i)
+    {
+        switch (k)
+        {
+        case Kernel::Copy:  c[i] = a[i]; break;
+        case Kernel::Scale: b[i] = SCALAR * c[i]; break;
+        case Kernel::Add:   c[i] = a[i] + b[i]; break;
+        case Kernel::Triad: a[i] = b[i] + SCALAR * c[i]; break;
+        }
+    }
+}
+
+/*
+Peak floating-point rate for the compute roof. Each lane runs an independent
+multiply-add chain so the loop is limited by arithmetic throughput, not latency.
+*/
+double measurePeakGflops(int threads)
+{
+    constexpr int LANES = 32;
+    constexpr int ITERATIONS = 1 << 20;
+    double sink = 0.0;
+
+    auto start = chrono::steady_clock::now();
+    #pragma omp parallel num_threads(threads) reduction(+ : sink)
+    {
+        double x[LANES];
+        for (int l = 0; l < LANES; ++l)
+            x[l] = 1.0 + l * 1e-9 + omp_get_thread_num() * 1e-12;
+
+        for (int it = 0; it < ITERATIONS; ++it)
+        {
+            #pragma omp simd
+            for (int l = 0; l < LANES; ++l)
+                x[l] = x[l] * 0.9999999 + 1e-7;
+        }
+
+        for (int l = 0; l < LANES; ++l)
+            sink += x[l];
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // volatile so the loop is not removed when asserts are compiled out
+    [[maybe_unused]] volatile double observed = sink;
+    assert(observed > 0.0);
+
+    const double flops = 2.0 * LANES * ITERATIONS * threads;
+    return flops / elapsed.count() / 1e9;
+}
+
+struct StreamResult
+{
+    Kernel kernel;
+    bool nonTemporal;
+    int threads;
+    double bestGBs;
+};
+
+// best-of-NTIMES bandwidth for every kernel and store variant at a given thread count
+vector<StreamResult> runStream(size_t n, int threads)
+{
+    AlignedArray a(n), b(n), c(n);
+    initArrays(a.get(), b.get(), c.get(), n, threads);
+
+    vector<StreamResult> results;
+    for (bool nonTemporal : {false, true})
+    {
+        for (Kernel k : {Kernel::Copy, Kernel::Scale, Kernel::Add, Kernel::Triad})
+        {
+            double best = 1e30;
+            for (int rep = 0; rep < NTIMES; ++rep)
+            {
+                auto start = chrono::steady_clock::now();
+                if (nonTemporal)
+                    runKernelNonTemporal(k, a.get(), b.get(), c.get(), n, threads);
+                else
+                    runKernel(k, a.get(), b.get(), c.get(), n, threads);
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+                // the first iteration is discarded as warm-up, as in STREAM
+                if (rep > 0)
+                    best = min(best, elapsed.count());
+            }
+
+            const double gbs = double(bytesPerElement(k)) * n / best / 1e9;
+            results.push_back({k, nonTemporal, threads, gbs});
+        }
+    }
+
+    return results;
+}
+
+// 1, 2, 4, ... up to the maximum thread count, always including the maximum
+vector<int> threadSweep()
+{
+    vector<int> counts;
+    const int maxThreads = omp_get_max_threads();
+    for (int t = 1; t < maxThreads; t *= 2)
+        counts.push_back(t);
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+/*
+Roofline CSV columns: kind,name,threads,intensity,gflops,gbs
+- 'roof' rows hold the measured memory and compute ceilings.
+- 'stream' rows hold every STREAM measurement.
+Other kernels can append 'kernel' rows with their own intensity and achieved gflops.
+*/
+void writeRooflineReport(const string &path, const vector<StreamResult> &results,
+                         const vector<pair<int, double>> &peakGflops)
+{
+    ofstream out(path);
+    out << "kind,name,threads,intensity,gflops,gbs\n";
+
+    double bestBandwidth = 0.0;
+    for (const StreamResult &r : results)
+    {
+        // copy moves no flops; scale 1 flop, add 1 flop, triad 2 flops per element
+        const double flops = r.kernel == Kernel::Copy ? 0.0 : r.kernel == Kernel::Triad ? 2.0 : 1.0;
+        const double intensity = flops / bytesPerElement(r.kernel);
+        out << "stream," << kernelName(r.kernel) << (r.nonTemporal ? "_nt" : "") << ','
+            << r.threads << ',' << intensity << ',' << intensity * r.bestGBs << ',' << r.bestGBs << '\n';
+        bestBandwidth = max(bestBandwidth, r.bestGBs);
+    }
+
+    double bestGflops = 0.0;
+    for (const auto &[threads, gflops] : peakGflops)
+    {
+        out << "roof,compute," << threads << ",," << gflops << ",\n";
+        bestGflops = max(bestGflops, gflops);
+    }
+
+    // the ridge point is the intensity where a kernel stops being memory-bound
+    out << "roof,memory," << omp_get_max_threads() << ",,," << bestBandwidth << '\n';
+    out << "roof,ridge," << omp_get_max_threads() << ',' << bestGflops / bestBandwidth << ','
+        << bestGflops << ',' << bestBandwidth << '\n';
+}
+
+// STREAM's own validation: replay the kernel sequence on scalars and compare
+void testStreamResults()
+{
+    const size_t n = 1000 + 3; // not a multiple of the block size
+    AlignedArray a(n), b(n), c(n);
+
+    for (bool nonTemporal : {false, true})
+    {
+        initArrays(a.get(), b.get(), c.get(), n, omp_get_max_threads());
+        double ea = 1.0, eb = 2.0, ec = 0.0;
+
+        for (int rep = 0; rep < 3; ++rep)
+        {
+            for (Kernel k : {Kernel::Copy, Kernel::Scale, Kernel::Add, Kernel::Triad})
+            {
+                if (nonTemporal)
+                    runKernelNonTemporal(k, a.get(), b.get(), c.get(), n, omp_get_max_threads());
+                else
+                    runKernel(k, a.get(), b.get(), c.get(), n, omp_get_max_threads());
+            }
+
+            ec = ea;
+            eb = SCALAR * ec;
+            ec = ea + eb;
+            ea = eb + SCALAR * ec;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            assert(a.get()[i] == ea);
+            assert(b.get()[i] == eb);
+            assert(c.get()[i] == ec);
+        }
+    }
+}
+
+void testThreadSweep()
+{
+    vector<int> counts = threadSweep();
+    assert(counts.front() == 1);
+    assert(counts.back() == omp_get_max_threads());
+    assert(is_sorted(counts.begin(), counts.end()));
+}
+
+/* Sample output:
+threads  kernel    GB/s    GB/s (nt)
+1        copy      9.77896    11.5799
+1        scale     9.52281    11.7301
+1        add       11.0879    14.0153
+1        triad     11.5629    12.933
+Peak compute (1 threads): 5.88814 GFLOP/s
+Roofline report written to stream_roofline.csv
+*/
+void benchmark(size_t n)
+{
+    cout << "Array size: " << n << " doubles (" << 3.0 * n * sizeof(double) / 1e6 << " MB total)\n";
+    cout << "threads  kernel    GB/s    GB/s (nt)\n";
+
+    vector<StreamResult> all;
+    vector<pair<int, double>> peaks;
+    for (int threads : threadSweep())
+    {
+        vector<StreamResult> results = runStream(n, threads);
+        for (size_t i = 0; i < results.size() / 2; ++i)
+        {
+            const StreamResult &normal = results[i];
+            const StreamResult &nt = results[i + results.size() / 2];
+            cout << threads << "\t " << kernelName(normal.kernel) << "\t   " << normal.bestGBs
+                 << "\t   " << nt.bestGBs << '\n';
+        }
+        all.insert(all.end(), results.begin(), results.end());
+
+        peaks.emplace_back(threads, measurePeakGflops(threads));
+        cout << "Peak compute (" << threads << " threads): " << peaks.back().second << " GFLOP/s\n";
+    }
+
+    const string path = "stream_roofline.csv";
+    writeRooflineReport(path, all, peaks);
+    cout << "Roofline report written to " << path << '\n';
+}
+
+void test()
+{
+    testStreamResults();
+    testThreadSweep();
+}
+
+// usage: Stream [elements per array]
+int main(int argc, char *argv[])
+{
+    test();
+
+    // default: 3 arrays of 8M doubles (192 MB), well beyond a typical last level cache
+    size_t n = argc > 1 ? stoull(argv[1]) : size_t(1) << 23;
+    benchmark(n);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
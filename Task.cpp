@@ -6,10 +6,10 @@ https://www.openmp.org/spec-html/5.0/openmpsu46.html
 
 Task vs Section:
 - Tasks are more suited for irregular parallelism such as through recursion.
-- Tasks have higher overhead to create and schedule compared to sections.
 - Sections are more suited for rigid parallelism where the # of parallel
     - units is known at compile-time.
-- Sections have lower overhead.
+- Tasks are often said to cost more to create and schedule than sections;
+    ParallelInvoke.cpp measures both.
 
 Syntax:
 #pragma omp parallel
@@ -38,7 +38,7 @@ using namespace std;
 
 // note how the recursive calls never create a new "#pragma omp parallel" region.
 // That is done in the calling function to avoid nesting. nested parallel regions
-// hinder performance.
+// hinder performance (see NestedParallel.cpp for measurements).
 int _fibonacci(int n)
 {
     if (n <= 2)
@@ -0,0 +1,466 @@
+/*
+taskloop splits the iterations of a loop into tasks. Unlike 'omp for', it does not
+need the whole team to reach it, so it works for loops nested inside task-parallel
+code: the tasks go to whichever threads are idle.
+https://www.openmp.org/spec-html/5.0/openmpsu47.html
+
+The size of the tasks is set with one of:
+- grainsize(g): each task gets between g and 2g iterations
+- num_tasks(n): the loop is split into n tasks
+
+Task reductions (OpenMP 5.0) replace the shared result plus taskwait pattern:
+- taskgroup task_reduction(+ : x): x is reduced over the tasks of the taskgroup
+- task in_reduction(+ : x):         this task adds into its own copy of x
+- taskloop reduction(+ : x):        both at once, for the tasks of one taskloop
+
+Syntax:
+#pragma omp parallel
+#pragma omp single
+{
+    #pragma omp taskloop grainsize(64) reduction(+ : sum)
+    for (int i = 0; i < n; ++i)
+        ...
+}
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/* Sample output:
+Thread 0 processing iteration 0
+Thread 0 processing iteration 1
+Thread 2 processing iteration 2
+Thread 2 processing iteration 3
+Thread 1 processing iteration 4
+Thread 1 processing iteration 5
+*/
+void grainsizeExample()
+{
+    omp_set_num_threads(3);
+
+    // tasks of 2 iterations each, taken by whichever thread is free.
+    // the same split as schedule(dynamic, 2) in Schedule.cpp.
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop grainsize(2)
+    for (int i = 0; i < 6; ++i)
+    {
+        #pragma omp critical
+        cout << "Thread " << omp_get_thread_num() << " processing iteration " << i << endl;
+    }
+
+    cout << "Grainsize done\n\n";
+}
+
+void numTasksExample()
+{
+    omp_set_num_threads(3);
+
+    // exactly 3 tasks, like schedule(static) with 3 threads, but not bound to threads
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop num_tasks(3)
+    for (int i = 0; i < 6; ++i)
+    {
+        #pragma omp critical
+        cout << "Thread " << omp_get_thread_num() << " processing iteration " << i << endl;
+    }
+
+    cout << "Num tasks done\n\n";
+}
+
+// iteration i costs about 'cost' steps. irregular loops make cost depend on i.
+double work(int i, int cost)
+{
+    double x = i;
+    for (int k = 0; k < cost; ++k)
+        x = sqrt(x + k);
+    return x;
+}
+
+int irregularCost(int i)
+{
+    return 1 + (i % 97) * 4; // 1..385 steps, a sawtooth
+}
+
+double serialSum(int n, bool irregular)
+{
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i)
+        sum += work(i, irregular ? irregularCost(i) : 64);
+    return sum;
+}
+
+double dynamicSum(int n, bool irregular, int chunk)
+{
+    double sum = 0.0;
+    #pragma omp parallel for schedule(dynamic, chunk) reduction(+ : sum)
+    for (int i = 0; i < n; ++i)
+        sum += work(i, irregular ? irregularCost(i) : 64);
+    return sum;
+}
+
+double grainsizeSum(int n, bool irregular, int grainsize)
+{
+    double sum = 0.0;
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop grainsize(grainsize) reduction(+ : sum)
+    for (int i = 0; i < n; ++i)
+        sum += work(i, irregular ? irregularCost(i) : 64);
+    return sum;
+}
+
+double numTasksSum(int n, bool irregular, int numTasks)
+{
+    double sum = 0.0;
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop num_tasks(numTasks) reduction(+ : sum)
+    for (int i = 0; i < n; ++i)
+        sum += work(i, irregular ? irregularCost(i) : 64);
+    return sum;
+}
+
+/*
+A loop nested in task-parallel code: one task per batch, each running a taskloop.
+'omp for' cannot be used here because the other threads are busy with other tasks,
+and a nested 'parallel for' would run on a single thread.
+*/
+vector<double> batchSums(const vector<vector<double>> &batches)
+{
+    vector<double> sums(batches.size(), 0.0);
+
+    #pragma omp parallel
+    #pragma omp single
+    for (size_t b = 0; b < batches.size(); ++b)
+    {
+        #pragma omp task firstprivate(b) shared(batches, sums)
+        {
+            const vector<double> &batch = batches[b];
+            const int n = static_cast<int>(batch.size());
+            double sum = 0.0;
+
+            #pragma omp taskloop grainsize(1024) reduction(+ : sum)
+            for (int i = 0; i < n; ++i)
+                sum += batch[i];
+
+            sums[b] = sum;
+        }
+    }
+
+    return sums;
+}
+
+// below this size the recursion runs serially inside one task
+constexpr int FIBONACCI_CUTOFF = 20;
+
+int serialFibonacci(int n)
+{
+    return n <= 2 ? n : serialFibonacci(n - 1) + serialFibonacci(n - 2);
+}
+
+// _fibonacci from Task.cpp: shared results and taskwait at every level
+int _fibonacciTaskwait(int n)
+{
+    if (n <= FIBONACCI_CUTOFF)
+        return serialFibonacci(n);
+
+    int x = -1, y = -1;
+    #pragma omp task shared(x)
+    x = _fibonacciTaskwait(n - 1);
+
+    #pragma omp task shared(y)
+    y = _fibonacciTaskwait(n - 2);
+
+    #pragma omp taskwait
+    return x + y;
+}
+
+int fibonacciTaskwait(int n)
+{
+    int result = -1;
+    #pragma omp parallel
+    #pragma omp single
+    result = _fibonacciTaskwait(n);
+    return result;
+}
+
+/*
+No taskwait: each subproblem below the cutoff adds its value into 'total' with
+in_reduction, and the taskgroup combines the copies at the end. 'total' always
+refers to the variable of the task_reduction; it is shared, never copied, by the
+tasks that only spawn more tasks.
+*/
+void _fibonacciReduction(int n, int &total)
+{
+    if (n <= FIBONACCI_CUTOFF)
+    {
+        #pragma omp task in_reduction(+ : total)
+        total += serialFibonacci(n);
+        return;
+    }
+
+    #pragma omp task shared(total)
+    _fibonacciReduction(n - 1, total);
+
+    _fibonacciReduction(n - 2, total);
+}
+
+int fibonacciReduction(int n)
+{
+    int total = 0;
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskgroup task_reduction(+ : total)
+    _fibonacciReduction(n, total);
+    return total;
+}
+
+class TreeNode
+{
+public:
+    int value{};
+    TreeNode *left = nullptr, *right = nullptr;
+
+    TreeNode(int val)
+        : value(val)
+    {
+    }
+};
+
+// subtrees at this depth become one task each
+constexpr int TREE_TASK_DEPTH = 8;
+
+int serialSumTree(TreeNode *node)
+{
+    return node == nullptr ? 0 : node->value + serialSumTree(node->left) + serialSumTree(node->right);
+}
+
+// _sumTree from Task.cpp
+int _sumTreeTaskwait(TreeNode *node, int depth)
+{
+    if (node == nullptr)
+        return 0;
+    if (depth >= TREE_TASK_DEPTH)
+        return serialSumTree(node);
+
+    int leftSum = 0, rightSum = 0;
+
+    #pragma omp task shared(leftSum) firstprivate(node)
+    leftSum = _sumTreeTaskwait(node->left, depth + 1);
+
+    #pragma omp task shared(rightSum) firstprivate(node)
+    rightSum = _sumTreeTaskwait(node->right, depth + 1);
+
+    #pragma omp taskwait
+    return node->value + leftSum + rightSum;
+}
+
+int sumTreeTaskwait(TreeNode *root)
+{
+    int totalSum = 0;
+    #pragma omp parallel
+    #pragma omp single
+    totalSum = _sumTreeTaskwait(root, 0);
+    return totalSum;
+}
+
+void _sumTreeReduction(TreeNode *node, int depth, int &total)
+{
+    if (node == nullptr)
+        return;
+
+    if (depth >= TREE_TASK_DEPTH)
+    {
+        #pragma omp task in_reduction(+ : total) firstprivate(node)
+        total += serialSumTree(node);
+        return;
+    }
+
+    // the spawning task adds this node's value itself
+    #pragma omp task in_reduction(+ : total) firstprivate(node)
+    total += node->value;
+
+    #pragma omp task shared(total) firstprivate(node)
+    _sumTreeReduction(node->left, depth + 1, total);
+
+    _sumTreeReduction(node->right, depth + 1, total);
+}
+
+int sumTreeReduction(TreeNode *root)
+{
+    int total = 0;
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskgroup task_reduction(+ : total)
+    _sumTreeReduction(root, 0, total);
+    return total;
+}
+
+// complete tree of the given depth. values are the breadth-first index mod 10, so sums fit in an int.
+TreeNode *buildTree(int depth, int index = 1)
+{
+    if (depth == 0)
+        return nullptr;
+
+    TreeNode *node = new TreeNode(index % 10);
+    node->left = buildTree(depth - 1, 2 * index);
+    node->right = buildTree(depth - 1, 2 * index + 1);
+    return node;
+}
+
+void deleteTree(TreeNode *node)
+{
+    if (node == nullptr)
+        return;
+    deleteTree(node->left);
+    deleteTree(node->right);
+    delete node;
+}
+
+void testTaskloopSums()
+{
+    const int n = 10'000;
+    for (bool irregular : {false, true})
+    {
+        const double expected = serialSum(n, irregular);
+        auto close = [&](double x) { return fabs(x - expected) <= 1e-9 * expected; };
+
+        assert(close(dynamicSum(n, irregular, 16)));
+        for (int grainsize : {1, 7, 1000, 100'000})
+            assert(close(grainsizeSum(n, irregular, grainsize)));
+        for (int numTasks : {1, 3, 64, 20'000})
+            assert(close(numTasksSum(n, irregular, numTasks)));
+    }
+}
+
+void testBatchSums()
+{
+    vector<vector<double>> batches;
+    for (int b = 0; b < 10; ++b)
+        batches.push_back(vector<double>(1000 * b + 1, double(b)));
+
+    const vector<double> sums = batchSums(batches);
+    for (int b = 0; b < 10; ++b)
+        assert(sums[b] == double(b) * (1000 * b + 1));
+}
+
+void testFibonacci()
+{
+    assert(fibonacciTaskwait(30) == 1346269);
+    assert(fibonacciReduction(30) == 1346269);
+    assert(fibonacciReduction(10) == serialFibonacci(10)); // below the cutoff
+}
+
+void testSumTree()
+{
+    // same tree as Task.cpp
+    TreeNode *root = new TreeNode(10);
+    root->left = new TreeNode(20);
+    root->right = new TreeNode(30);
+    root->left->left = new TreeNode(40);
+    root->left->right = new TreeNode(50);
+    assert(sumTreeTaskwait(root) == 150);
+    assert(sumTreeReduction(root) == 150);
+    deleteTree(root);
+
+    // deeper than TREE_TASK_DEPTH
+    root = buildTree(14);
+    const int expected = serialSumTree(root);
+    assert(expected > 0);
+    assert(sumTreeTaskwait(root) == expected);
+    assert(sumTreeReduction(root) == expected);
+    deleteTree(root);
+}
+
+template <typename Fn>
+double bestMs(Fn fn)
+{
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep)
+    {
+        auto start = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+/* Sample output (1 core):
+4 threads, 200000 iterations     uniform ms   irregular ms
+parallel for dynamic, 1          56.9312        251.546
+parallel for dynamic, 64         57.0059        240.111
+taskloop grainsize(1)            54.916        235.54
+taskloop grainsize(16)           64.6016        250.191
+taskloop grainsize(256)          64.5076        241.965
+taskloop grainsize(4096)         54.6612        235.165
+taskloop num_tasks(4)            54.2398        239.127
+taskloop num_tasks(16)           57.4663        241.147
+taskloop num_tasks(64)           54.5563        235.533
+taskloop num_tasks(1024)         54.6684        233.712
+fibonacci(35), taskwait:        9.73735 ms
+fibonacci(35), task_reduction:  9.72119 ms
+sumTree(2^22 nodes), taskwait:       25.0448 ms
+sumTree(2^22 nodes), task_reduction: 24.7109 ms
+*/
+void benchmark()
+{
+    const int n = 200'000;
+    const int threads = omp_get_max_threads();
+    cout << threads << " threads, " << n << " iterations     uniform ms   irregular ms\n";
+
+    auto row = [&](const string &name, auto fn) {
+        cout << name << string(max<size_t>(1, 33 - name.size()), ' ') << bestMs([&] { fn(false); })
+             << "        " << bestMs([&] { fn(true); }) << '\n';
+    };
+
+    for (int chunk : {1, 64})
+        row("parallel for dynamic, " + to_string(chunk), [&](bool irregular) { dynamicSum(n, irregular, chunk); });
+    for (int grainsize : {1, 16, 256, 4096})
+        row("taskloop grainsize(" + to_string(grainsize) + ")", [&](bool irregular) { grainsizeSum(n, irregular, grainsize); });
+    for (int numTasks : {threads, 4 * threads, 16 * threads, 256 * threads})
+        row("taskloop num_tasks(" + to_string(numTasks) + ")", [&](bool irregular) { numTasksSum(n, irregular, numTasks); });
+
+    cout << "fibonacci(35), taskwait:        " << bestMs([] { fibonacciTaskwait(35); }) << " ms\n";
+    cout << "fibonacci(35), task_reduction:  " << bestMs([] { fibonacciReduction(35); }) << " ms\n";
+
+    TreeNode *root = buildTree(22);
+    cout << "sumTree(2^22 nodes), taskwait:       " << bestMs([&] { sumTreeTaskwait(root); }) << " ms\n";
+    cout << "sumTree(2^22 nodes), task_reduction: " << bestMs([&] { sumTreeReduction(root); }) << " ms\n";
+    deleteTree(root);
+}
+
+void test()
+{
+    const int threads = omp_get_max_threads();
+    grainsizeExample();
+    numTasksExample();
+    omp_set_num_threads(threads);
+
+    testTaskloopSums();
+    testBatchSums();
+    testFibonacci();
+    testSumTree();
+}
+
+int main()
+{
+    test();
+    benchmark();
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
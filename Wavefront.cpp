@@ -0,0 +1,345 @@
+/*
+Wavefront dynamic programming: edit distance and longest common subsequence (LCS).
+
+testLoopDependence in ParallelFor.cpp shows a loop that cannot run in parallel
+because every iteration needs the previous one. DP tables are the same problem in
+2D: cell (i, j) needs (i - 1, j), (i, j - 1) and (i - 1, j - 1). Cells that can run
+at the same time are:
+- anti-diagonals: all cells with i + j = d depend only on diagonals d - 1 and d - 2.
+  One 'omp for simd' per diagonal, and a barrier before the next. There are n + m
+  diagonals, so n + m barriers, and the first and last diagonals are short.
+- tiles: cut the table into T x T tiles. Tile (ti, tj) needs the tiles above and to
+  its left, which 'task depend' expresses directly. A tile starts as soon as its two
+  neighbours are done, with no barrier at all.
+
+Only the score is kept, not the alignment, so no version stores the table:
+- serial: one row, updated left to right
+- wavefront: three diagonals, rotated
+- tiled: the bottom row and right column of the last tile in every tile column and
+  tile row, plus the corner of every tile
+
+Syntax:
+#pragma omp task depend(in : tile[ti - 1][tj], tile[ti][tj - 1]) depend(out : tile[ti][tj])
+
+Usage: Wavefront [largest length]
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// D[i][j]: edits to turn the first i characters of a into the first j of b
+struct EditDistance
+{
+    static int boundary(int k) { return k; } // D[k][0] = D[0][k] = k
+    static int cell(int up, int left, int diagonal, bool equal)
+    {
+        return min({up + 1, left + 1, diagonal + (equal ? 0 : 1)});
+    }
+};
+
+// L[i][j]: length of the LCS of the first i characters of a and the first j of b
+struct Lcs
+{
+    static int boundary(int) { return 0; }
+    static int cell(int up, int left, int diagonal, bool equal)
+    {
+        return equal ? diagonal + 1 : max(up, left);
+    }
+};
+
+// the whole table, for the tests
+template <typename Dp>
+int fullTable(const string &a, const string &b)
+{
+    const int n = static_cast<int>(a.size()), m = static_cast<int>(b.size());
+    vector<vector<int>> table(n + 1, vector<int>(m + 1));
+    for (int i = 0; i <= n; ++i)
+        table[i][0] = Dp::boundary(i);
+    for (int j = 0; j <= m; ++j)
+        table[0][j] = Dp::boundary(j);
+    for (int i = 1; i <= n; ++i)
+        for (int j = 1; j <= m; ++j)
+            table[i][j] = Dp::cell(table[i - 1][j], table[i][j - 1], table[i - 1][j - 1], a[i - 1] == b[j - 1]);
+    return table[n][m];
+}
+
+// one row of m + 1 cells
+template <typename Dp>
+int serialScore(const string &a, const string &b)
+{
+    const int n = static_cast<int>(a.size()), m = static_cast<int>(b.size());
+    vector<int> row(m + 1);
+    for (int j = 0; j <= m; ++j)
+        row[j] = Dp::boundary(j);
+
+    for (int i = 1; i <= n; ++i)
+    {
+        int diagonal = row[0]; // D[i - 1][j - 1]
+        row[0] = Dp::boundary(i);
+        for (int j = 1; j <= m; ++j)
+        {
+            const int up = row[j];
+            row[j] = Dp::cell(up, row[j - 1], diagonal, a[i - 1] == b[j - 1]);
+            diagonal = up;
+        }
+    }
+    return row[m];
+}
+
+/*
+Diagonal d holds the cells (i, d - i), indexed by i. b is reversed so that the cells
+of a diagonal read both strings forwards: b[d - i - 1] == reversed[m - d + i].
+*/
+template <typename Dp>
+int wavefrontScore(const string &a, const string &b)
+{
+    const int n = static_cast<int>(a.size()), m = static_cast<int>(b.size());
+    const string reversed(b.rbegin(), b.rend());
+    vector<int> buffers[3] = {vector<int>(n + 1), vector<int>(n + 1), vector<int>(n + 1)};
+    buffers[0][0] = Dp::boundary(0);
+
+    #pragma omp parallel
+    {
+        for (int d = 1; d <= n + m; ++d)
+        {
+            int *current = buffers[d % 3].data();
+            const int *previous = buffers[(d + 2) % 3].data();     // d - 1
+            const int *beforePrevious = buffers[(d + 1) % 3].data(); // d - 2
+            const int first = max(1, d - m), last = min(n, d - 1);   // cells off the boundary
+
+            #pragma omp for simd schedule(static) nowait
+            for (int i = first; i <= last; ++i)
+                current[i] = Dp::cell(previous[i - 1], previous[i], beforePrevious[i - 1], a[i - 1] == reversed[m - d + i]);
+
+            // the boundary cells (0, d) and (d, 0), if on this diagonal. outside [first, last].
+            #pragma omp single
+            {
+                if (d <= m)
+                    current[0] = Dp::boundary(d);
+                if (d <= n)
+                    current[d] = Dp::boundary(d);
+            } // the only barrier of the diagonal
+        }
+    }
+    return buffers[(n + m) % 3][n];
+}
+
+/*
+Tiles of 'tile' x 'tile' cells of rows 1..n and columns 1..m. Shared state:
+- bottom[j]: the last row computed in column j (initially row 0)
+- right[i]:  the last column computed in row i (initially column 0)
+- corners:   the bottom-right cell of every tile, which the tile below and to the
+             right needs after bottom and right have been overwritten
+Tiles in the same tile row write the same part of 'right', but the dependences order
+them, so no two running tiles share any of it.
+*/
+template <typename Dp>
+int tiledScore(const string &a, const string &b, int tile = 1024)
+{
+    const int n = static_cast<int>(a.size()), m = static_cast<int>(b.size());
+    if (n == 0 || m == 0)
+        return Dp::boundary(max(n, m));
+
+    const int tilesN = (n + tile - 1) / tile, tilesM = (m + tile - 1) / tile;
+    vector<int> bottom(m + 1), right(n + 1), corners(size_t(tilesN) * tilesM);
+    for (int j = 0; j <= m; ++j)
+        bottom[j] = Dp::boundary(j);
+    for (int i = 0; i <= n; ++i)
+        right[i] = Dp::boundary(i);
+
+    // one dependence object per tile
+    vector<char> done(size_t(tilesN) * tilesM);
+    char *deps = done.data();
+
+    auto computeTile = [&](int ti, int tj) {
+        const int i0 = ti * tile + 1, i1 = min(n, (ti + 1) * tile);
+        const int j0 = tj * tile + 1, j1 = min(m, (tj + 1) * tile);
+        const int width = j1 - j0 + 1;
+
+        // row[k] is column j0 - 1 + k
+        vector<int> row(width + 1);
+        row[0] = ti == 0 ? Dp::boundary(j0 - 1) : tj == 0 ? Dp::boundary(i0 - 1) : corners[size_t(ti - 1) * tilesM + tj - 1];
+        copy(bottom.begin() + j0, bottom.begin() + j1 + 1, row.begin() + 1);
+
+        for (int i = i0; i <= i1; ++i)
+        {
+            int diagonal = row[0];
+            row[0] = right[i];
+            const char ai = a[i - 1];
+            for (int k = 1; k <= width; ++k)
+            {
+                const int up = row[k];
+                row[k] = Dp::cell(up, row[k - 1], diagonal, ai == b[j0 + k - 2]);
+                diagonal = up;
+            }
+            right[i] = row[width];
+        }
+        copy(row.begin() + 1, row.end(), bottom.begin() + j0);
+        corners[size_t(ti) * tilesM + tj] = row[width];
+    };
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            for (int ti = 0; ti < tilesN; ++ti)
+            {
+                for (int tj = 0; tj < tilesM; ++tj)
+                {
+                    const size_t self = size_t(ti) * tilesM + tj;
+                    const size_t up = ti > 0 ? self - tilesM : self;
+                    const size_t left = tj > 0 ? self - 1 : self;
+
+                    #pragma omp task firstprivate(ti, tj) depend(in : deps[up], deps[left]) depend(out : deps[self])
+                    computeTile(ti, tj);
+                }
+            }
+        } // the barrier at the end of single waits for every tile
+    }
+    return bottom[m];
+}
+
+// a random string over ACGT, and a copy with about 'rate' of its characters edited
+string randomDna(int length, mt19937 &rng)
+{
+    string s(length, ' ');
+    for (char &c : s)
+        c = "ACGT"[rng() % 4];
+    return s;
+}
+
+string mutate(const string &s, double rate, mt19937 &rng)
+{
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    string result;
+    for (char c : s)
+    {
+        const double r = uniform(rng);
+        if (r < rate / 3)
+            continue;                                       // delete
+        else if (r < 2 * rate / 3)
+            result += string{"ACGT"[rng() % 4], c};         // insert
+        else
+            result += r < rate ? "ACGT"[rng() % 4] : c;     // substitute, or keep
+    }
+    return result;
+}
+
+void testKnownValues()
+{
+    assert(serialScore<EditDistance>("kitten", "sitting") == 3);
+    assert(serialScore<EditDistance>("", "abc") == 3);
+    assert(serialScore<EditDistance>("abc", "") == 3);
+    assert(serialScore<EditDistance>("flaw", "lawn") == 2);
+    assert(serialScore<Lcs>("ABCBDAB", "BDCABA") == 4);
+    assert(serialScore<Lcs>("AGGTAB", "GXTXAYB") == 4);
+
+    for (auto [a, b] : {pair<string, string>{"kitten", "sitting"}, {"", "abc"}, {"abc", ""}, {"", ""}, {"x", "x"}})
+    {
+        assert(wavefrontScore<EditDistance>(a, b) == fullTable<EditDistance>(a, b));
+        assert(tiledScore<EditDistance>(a, b, 2) == fullTable<EditDistance>(a, b));
+        assert(wavefrontScore<Lcs>(a, b) == fullTable<Lcs>(a, b));
+        assert(tiledScore<Lcs>(a, b, 2) == fullTable<Lcs>(a, b));
+    }
+}
+
+void testRandomStrings()
+{
+    mt19937 rng(1);
+    const int saved = omp_get_max_threads();
+    for (int threads : {1, 2, 3, 8})
+    {
+        omp_set_num_threads(threads);
+        for (auto [n, m] : {pair{1, 50}, pair{50, 1}, pair{200, 180}, pair{333, 500}})
+        {
+            const string a = randomDna(n, rng), b = mutate(randomDna(m, rng), 0.1, rng);
+            const int edits = fullTable<EditDistance>(a, b), common = fullTable<Lcs>(a, b);
+
+            assert(serialScore<EditDistance>(a, b) == edits);
+            assert(wavefrontScore<EditDistance>(a, b) == edits);
+            assert(serialScore<Lcs>(a, b) == common);
+            assert(wavefrontScore<Lcs>(a, b) == common);
+
+            // tiles that do and do not divide the lengths
+            for (int tile : {1, 7, 64, 1024})
+            {
+                assert(tiledScore<EditDistance>(a, b, tile) == edits);
+                assert(tiledScore<Lcs>(a, b, tile) == common);
+            }
+        }
+    }
+    omp_set_num_threads(saved);
+}
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output (1 core, so the gains over serial are from simd and locality, not threads):
+4 threads, DNA strings with 10% edits, Gcells/s
+length	problem		serial	wavefront	tiled
+10000	edit distance	0.336933	0.390977		0.333107
+10000	lcs		0.339387	0.566124		1.19454
+100000	edit distance	0.330687	0.790108		0.342613
+100000	lcs		0.299134	2.13467		1.17425
+*/
+void benchmark(int largest)
+{
+    cout << omp_get_max_threads() << " threads, DNA strings with 10% edits, Gcells/s\n";
+    cout << "length\tproblem\t\tserial\twavefront\ttiled\n";
+
+    mt19937 rng(2);
+    for (int length = 10'000; length <= largest; length = length < largest && length * 10 > largest ? largest : length * 10)
+    {
+        const string a = randomDna(length, rng);
+        const string b = mutate(a, 0.1, rng);
+        const double cells = double(a.size()) * b.size() / 1e9;
+
+        auto row = [&](const char *name, auto serial, auto wavefront, auto tiled) {
+            int expected = 0, result = 0;
+            cout << length << '\t' << name << '\t' << cells / secondsFor([&] { expected = serial(a, b); });
+            cout << '\t' << cells / secondsFor([&] { result = wavefront(a, b); });
+            assert(result == expected);
+            cout << "\t\t" << cells / secondsFor([&] { result = tiled(a, b); }) << '\n';
+            assert(result == expected);
+        };
+
+        row("edit distance", serialScore<EditDistance>, wavefrontScore<EditDistance>,
+            [](const string &x, const string &y) { return tiledScore<EditDistance>(x, y); });
+        row("lcs\t", serialScore<Lcs>, wavefrontScore<Lcs>,
+            [](const string &x, const string &y) { return tiledScore<Lcs>(x, y); });
+        if (length == largest)
+            break;
+    }
+}
+
+void test()
+{
+    testKnownValues();
+    testRandomStrings();
+}
+
+int main(int argc, char *argv[])
+{
+    test();
+    benchmark(argc > 1 ? stoi(argv[1]) : 100'000);
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}
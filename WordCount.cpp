@@ -0,0 +1,482 @@
+/*
+Word count and group-by over large text files.
+
+1. The file is memory-mapped (mmap / MapViewOfFile), so no thread copies the input.
+2. The mapping is split into one chunk per thread. Each chunk boundary is moved
+   forward to the next newline so no record is split between two threads.
+3. Each thread counts into its own unordered_map keyed by string_view into the
+   mapping. No locking is needed while counting.
+4. Partitioned merge: each thread splits its map into P buckets by key hash.
+   After a barrier, thread p merges bucket p from every thread into final
+   partition p. Every key belongs to exactly one partition, so the merge is
+   also lock-free and all threads take part in it.
+
+Baselines:
+- a single-threaded ifstream/getline loop
+- a parallel loop that updates one global map inside '#pragma omp critical'
+*/
+
+#include "omp.h"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// read-only view of a whole file. throws if the file cannot be opened or mapped.
+class MappedFile
+{
+public:
+    explicit MappedFile(const string &path)
+    {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw runtime_error("cannot open " + path);
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+        if (size_ == 0)
+            return;
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_ == nullptr)
+            throw runtime_error("cannot map " + path);
+        data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            throw runtime_error("cannot open " + path);
+
+        struct stat st{};
+        fstat(fd_, &st);
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0)
+            return;
+
+        void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED)
+            throw runtime_error("cannot map " + path);
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(p);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+#else
+        if (data_)
+            munmap(const_cast<char *>(data_), size_);
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    string_view view() const { return {data_, size_}; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// split 'text' into at most 'parts' chunks that each end just after a newline (or at the end)
+vector<string_view> splitAtRecords(string_view text, int parts)
+{
+    vector<string_view> chunks;
+    size_t begin = 0;
+    for (int p = 1; p <= parts && begin < text.size(); ++p)
+    {
+        size_t end = (p == parts) ? text.size() : max(begin, text.size() * p / parts);
+        if (end < text.size())
+        {
+            size_t newline = text.find('\n', end);
+            end = (newline == string_view::npos) ? text.size() : newline + 1;
+        }
+        if (end > begin)
+            chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+inline bool isWordChar(char c)
+{
+    return isalnum(static_cast<unsigned char>(c)) || c == '\'';
+}
+
+// calls fn(word) for every maximal run of word characters
+template <typename Fn>
+void forEachWord(string_view text, Fn fn)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        while (i < text.size() && !isWordChar(text[i]))
+            ++i;
+        size_t start = i;
+        while (i < text.size() && isWordChar(text[i]))
+            ++i;
+        if (i > start)
+            fn(text.substr(start, i - start));
+    }
+}
+
+struct GroupStats
+{
+    long long count = 0;
+    double sum = 0.0;
+
+    void add(const GroupStats &other)
+    {
+        count += other.count;
+        sum += other.sum;
+    }
+};
+
+// the number at the start of 'field' (after spaces), 0 if there is none, like strtod
+double parseValue(string_view field)
+{
+    while (!field.empty() && isspace(static_cast<unsigned char>(field.front())))
+        field.remove_prefix(1);
+    if (!field.empty() && field.front() == '+') // from_chars does not accept a leading '+'
+        field.remove_prefix(1);
+
+    double value = 0.0;
+    auto [end, error] = from_chars(field.data(), field.data() + field.size(), value);
+    return error == errc() ? value : 0.0;
+}
+
+// calls fn(key, value) for every "key,value" line. lines without a comma are skipped.
+template <typename Fn>
+void forEachRecord(string_view text, Fn fn)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        size_t eol = text.find('\n', i);
+        if (eol == string_view::npos)
+            eol = text.size();
+
+        string_view line = text.substr(i, eol - i);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        size_t comma = line.find(',');
+        if (comma != string_view::npos)
+            fn(line.substr(0, comma), parseValue(line.substr(comma + 1)));
+
+        i = eol + 1;
+    }
+}
+
+template <typename V>
+using PartitionedMap = vector<unordered_map<string_view, V>>;
+
+/*
+Counts with per-thread maps and merges them with a partitioned merge.
+'accumulate(text, map)' fills a thread's map from its chunk and 'combine(into, from)'
+merges one value into another. Returns one map per partition; keys are disjoint.
+*/
+template <typename V, typename Accumulate, typename Combine>
+PartitionedMap<V> parallelAggregate(string_view text, Accumulate accumulate, Combine combine)
+{
+    const int P = omp_get_max_threads();
+    const vector<string_view> chunks = splitAtRecords(text, P);
+
+    // buckets[t][p] holds the entries of thread t whose key hashes to partition p
+    vector<vector<vector<pair<string_view, V>>>> buckets(P, vector<vector<pair<string_view, V>>>(P));
+    PartitionedMap<V> partitions(P);
+
+    #pragma omp parallel num_threads(P)
+    {
+        const int t = omp_get_thread_num();
+        const int nthreads = omp_get_num_threads();
+
+        unordered_map<string_view, V> local;
+        for (size_t c = t; c < chunks.size(); c += nthreads)
+            accumulate(chunks[c], local);
+
+        hash<string_view> hasher;
+        for (auto &entry : local)
+            buckets[t][hasher(entry.first) % nthreads].push_back(entry);
+
+        // every thread must finish bucketing before any partition is merged
+        #pragma omp barrier
+
+        unordered_map<string_view, V> &mine = partitions[t];
+        for (int from = 0; from < nthreads; ++from)
+        {
+            for (auto &[key, value] : buckets[from][t])
+                combine(mine[key], value);
+        }
+    }
+
+    return partitions;
+}
+
+PartitionedMap<long long> parallelWordCount(string_view text)
+{
+    return parallelAggregate<long long>(
+        text,
+        [](string_view chunk, unordered_map<string_view, long long> &counts) {
+            forEachWord(chunk, [&](string_view word) { ++counts[word]; });
+        },
+        [](long long &into, long long from) { into += from; });
+}
+
+PartitionedMap<GroupStats> parallelGroupBy(string_view text)
+{
+    return parallelAggregate<GroupStats>(
+        text,
+        [](string_view chunk, unordered_map<string_view, GroupStats> &groups) {
+            forEachRecord(chunk, [&](string_view key, double value) {
+                GroupStats &g = groups[key];
+                ++g.count;
+                g.sum += value;
+            });
+        },
+        [](GroupStats &into, const GroupStats &from) { into.add(from); });
+}
+
+// baseline: single thread reading through an ifstream
+unordered_map<string, long long> serialWordCount(const string &path)
+{
+    unordered_map<string, long long> counts;
+    ifstream in(path, ios::binary);
+    string line;
+    while (getline(in, line))
+        forEachWord(line, [&](string_view word) { ++counts[string(word)]; });
+    return counts;
+}
+
+// baseline: parallel tokenizing with one shared map behind a critical section
+unordered_map<string_view, long long> criticalWordCount(string_view text)
+{
+    unordered_map<string_view, long long> counts;
+    const vector<string_view> chunks = splitAtRecords(text, omp_get_max_threads());
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < static_cast<int>(chunks.size()); ++c)
+    {
+        forEachWord(chunks[c], [&](string_view word) {
+            #pragma omp critical(wordCountMap)
+            ++counts[word];
+        });
+    }
+
+    return counts;
+}
+
+// flatten partitions into one map with owned keys, for comparisons
+template <typename V>
+unordered_map<string, V> flatten(const PartitionedMap<V> &partitions)
+{
+    unordered_map<string, V> result;
+    for (const auto &partition : partitions)
+    {
+        for (const auto &[key, value] : partition)
+        {
+            // keys must be unique across partitions
+            assert(result.count(string(key)) == 0);
+            result.emplace(string(key), value);
+        }
+    }
+    return result;
+}
+
+string writeTempFile(const string &name, const string &contents)
+{
+    string path = (filesystem::temp_directory_path() / name).string();
+    ofstream(path, ios::binary) << contents;
+    return path;
+}
+
+void testSplitAtRecords()
+{
+    string text = "a,1\nbb,2\nccc,3\ndddd,4\n";
+    for (int parts = 1; parts <= 8; ++parts)
+    {
+        vector<string_view> chunks = splitAtRecords(text, parts);
+
+        // chunks cover the text in order and end at record boundaries
+        string joined;
+        for (string_view c : chunks)
+        {
+            assert(c.back() == '\n');
+            joined += c;
+        }
+        assert(joined == text);
+    }
+
+    // text without a trailing newline
+    vector<string_view> chunks = splitAtRecords("one two\nthree", 4);
+    assert(chunks.back() == "three");
+}
+
+void testWordCount()
+{
+    const string text = "the cat\nthe dog\r\nthe cat's toy\n\n  dog, dog!";
+    const string path = writeTempFile("WordCount_test.txt", text);
+    {
+        MappedFile file(path);
+        assert(file.view() == text);
+
+        unordered_map<string, long long> counts = flatten(parallelWordCount(file.view()));
+        assert(counts.size() == 5);
+        assert(counts["the"] == 3);
+        assert(counts["cat"] == 1);
+        assert(counts["cat's"] == 1);
+        assert(counts["dog"] == 3);
+        assert(counts["toy"] == 1);
+
+        assert(serialWordCount(path) == counts);
+
+        unordered_map<string_view, long long> critical = criticalWordCount(file.view());
+        assert(critical.size() == counts.size());
+        for (const auto &[word, n] : critical)
+            assert(counts[string(word)] == n);
+    }
+    filesystem::remove(path);
+}
+
+void testGroupBy()
+{
+    // values are read like strtod: leading spaces and '+' are fine, no number counts as 0
+    const string text = "red,1.5\nblue,2\nred,2.5\ngreen,10\nblue,-1\nno comma\ngreen, +0.5\nblue,abc\n";
+    unordered_map<string, GroupStats> groups = flatten(parallelGroupBy(text));
+
+    assert(groups.size() == 3);
+    assert(groups["red"].count == 2 && groups["red"].sum == 4.0);
+    assert(groups["blue"].count == 3 && groups["blue"].sum == 1.0);
+    assert(groups["green"].count == 2 && groups["green"].sum == 10.5);
+}
+
+// lines of random words drawn from a Zipf-like vocabulary, like natural text
+string generateText(size_t bytes)
+{
+    vector<string> vocabulary;
+    for (int i = 0; i < 50'000; ++i)
+        vocabulary.push_back("w" + to_string(i));
+
+    mt19937 rng(42);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    string text;
+    text.reserve(bytes + 64);
+    while (text.size() < bytes)
+    {
+        for (int w = 0; w < 12; ++w)
+        {
+            // cubing biases the draw toward frequent (low-index) words
+            double u = uniform(rng);
+            text += vocabulary[static_cast<size_t>(u * u * u * vocabulary.size())];
+            text += ' ';
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+template <typename Fn>
+double secondsFor(Fn fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Sample output:
+Input: 67 MB, 1 threads
+  ifstream (1 thread): 0.0478209 GB/s
+  global critical:     0.0371443 GB/s
+  per-thread + merge:  0.0400181 GB/s
+*/
+void benchmark(const string &path)
+{
+    MappedFile file(path);
+    const double gb = file.view().size() / 1e9;
+    cout << "Input: " << file.view().size() / 1'000'000 << " MB, " << omp_get_max_threads() << " threads\n";
+
+    size_t serialWords = 0, criticalWords = 0, parallelWords = 0;
+    double serial = secondsFor([&] { serialWords = serialWordCount(path).size(); });
+    double critical = secondsFor([&] { criticalWords = criticalWordCount(file.view()).size(); });
+    double parallel = secondsFor([&] {
+        for (const auto &partition : parallelWordCount(file.view()))
+            parallelWords += partition.size();
+    });
+
+    assert(serialWords == criticalWords && criticalWords == parallelWords);
+
+    cout << "  ifstream (1 thread): " << gb / serial << " GB/s\n";
+    cout << "  global critical:     " << gb / critical << " GB/s\n";
+    cout << "  per-thread + merge:  " << gb / parallel << " GB/s\n";
+}
+
+void test()
+{
+    testSplitAtRecords();
+    testWordCount();
+    testGroupBy();
+}
+
+// usage: WordCount [text file]. Without a file, a 64 MB sample file is generated.
+int main(int argc, char *argv[])
+{
+    test();
+
+    if (argc > 1)
+    {
+        benchmark(argv[1]);
+    }
+    else
+    {
+        const string path = writeTempFile("WordCount_bench.txt", generateText(size_t(64) << 20));
+        benchmark(path);
+        filesystem::remove(path);
+    }
+
+    cout << endl
+         << __FILE__ " tests passed!" << endl;
+    return 0;
+}